@@ -0,0 +1,284 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+/*	cscope - interactive C symbol cross-reference
+ *
+ *	block-compressed cross-reference
+ *
+ *	With -z the cross-reference is written as usual and then packed:
+ *	its header, each BUFSIZ block of the cross-reference up to the
+ *	trailer compressed on its own, a table of the packed blocks'
+ *	offsets, and the trailer as it was.  The header's trailer offset
+ *	and its -z offset of the block table are where they are in the
+ *	packed file, so the header and trailer are read as before, while
+ *	read_block() and dbseek() unpack just the block they need and the
+ *	database offsets in the cross-reference and the inverted index are
+ *	unchanged.
+ *
+ *	The blocks are compressed by matching each four bytes against the
+ *	last place they were seen in the block, in the manner of LZ4: a
+ *	sequence is a token byte holding the literal byte count and the
+ *	match length less four, each extended by following bytes up to
+ *	255 if it is 15, the literal bytes, and the match's two byte
+ *	offset back.  The last sequence has only literals.
+ */
+
+#include "global.h"
+#include "alloc.h"
+#include "blocks.h"
+#include "vp.h"
+
+#include <unistd.h>
+
+#define	HASHBITS	12		/* bits of the match table index */
+#define	MINMATCH	4		/* shortest match */
+#define	MAXOFFSET	65535		/* farthest match */
+
+BOOL	blockcompress = NO;	/* block-compress the cross-reference */
+long	blocktable;		/* offset of its block table, or 0 */
+
+static	long	*blockoffset;	/* offset of each packed block, and the end */
+static	long	nblocks;	/* number of packed blocks */
+static	char	packed[PACKMAX]; /* packed block read */
+
+/* Internal prototypes: */
+static	unsigned char *putlength(unsigned char *op, int n);
+static	unsigned char *putsequence(unsigned char *op, unsigned char *lit,
+				   int nlit, int offset, int len);
+
+
+/* pack a block, returning its packed size, which is at most PACKMAX
+   for a block of BUFSIZ */
+int
+packblock(char *in, int size, char *out)
+{
+    static int last[1 << HASHBITS];	/* last position of each hash */
+    unsigned char *s = (unsigned char *) in;
+    unsigned char *op = (unsigned char *) out;
+    unsigned long v;
+    int     anchor = 0;		/* first literal not yet output */
+    int     pos = 0;
+    int     ref, len, h;
+
+    for (h = 0; h < (1 << HASHBITS); ++h) {
+	last[h] = -1;
+    }
+    while (pos + MINMATCH <= size) {
+	v = s[pos] | s[pos + 1] << 8 | s[pos + 2] << 16
+	    | (unsigned long) s[pos + 3] << 24;
+	h = ((v * 2654435761UL) & 0xffffffffUL) >> (32 - HASHBITS);
+	ref = last[h];
+	last[h] = pos;
+	if (ref < 0 || pos - ref > MAXOFFSET
+	    || memcmp(s + ref, s + pos, MINMATCH) != 0) {
+	    ++pos;
+	    continue;
+	}
+	for (len = MINMATCH; pos + len < size && s[ref + len] == s[pos + len];
+	     ++len) {
+	    ;
+	}
+	op = putsequence(op, s + anchor, pos - anchor, pos - ref, len);
+	pos += len;
+	anchor = pos;
+    }
+    op = putsequence(op, s + anchor, size - anchor, 0, 0);
+    return(op - (unsigned char *) out);
+}
+
+
+/* output a sequence of literals and a match, or only literals if the
+   match length is 0 */
+static unsigned char *
+putsequence(unsigned char *op, unsigned char *lit, int nlit, int offset,
+	    int len)
+{
+    int     token;
+
+    token = (nlit < 15 ? nlit : 15) << 4;
+    if (len > 0) {
+	len -= MINMATCH;
+	token |= len < 15 ? len : 15;
+    }
+    *op++ = token;
+    if (nlit >= 15) {
+	op = putlength(op, nlit - 15);
+    }
+    memcpy(op, lit, nlit);
+    op += nlit;
+    if (offset > 0) {
+	*op++ = offset & 0xff;
+	*op++ = offset >> 8;
+	if (len >= 15) {
+	    op = putlength(op, len - 15);
+	}
+    }
+    return(op);
+}
+
+
+/* output the rest of a length that did not fit in the token */
+static unsigned char *
+putlength(unsigned char *op, int n)
+{
+    for (; n >= 255; n -= 255) {
+	*op++ = 255;
+    }
+    *op++ = n;
+    return(op);
+}
+
+
+/* unpack a block into at most max bytes, returning its size, or -1 if
+   it is corrupt */
+int
+unpackblock(char *in, int size, char *out, int max)
+{
+    unsigned char *ip = (unsigned char *) in;
+    unsigned char *end = ip + size;
+    char    *op = out;
+    char    *match;
+    int     token, offset, n, c;
+
+    while (ip < end) {
+	token = *ip++;
+	if ((n = token >> 4) == 15) {
+	    do {
+		if (ip == end) {
+		    return(-1);
+		}
+		n += c = *ip++;
+	    } while (c == 255);
+	}
+	if (n > end - ip || n > out + max - op) {
+	    return(-1);
+	}
+	memcpy(op, ip, n);
+	ip += n;
+	op += n;
+	if (ip == end) {
+	    break;
+	}
+	if (end - ip < 2) {
+	    return(-1);
+	}
+	offset = ip[0] | ip[1] << 8;
+	ip += 2;
+	if ((n = token & 15) == 15) {
+	    do {
+		if (ip == end) {
+		    return(-1);
+		}
+		n += c = *ip++;
+	    } while (c == 255);
+	}
+	n += MINMATCH;
+	if (offset == 0 || offset > op - out || n > out + max - op) {
+	    return(-1);
+	}
+	/* the match may overlap what it is copied to */
+	for (match = op - offset; n > 0; --n) {
+	    *op++ = *match++;
+	}
+    }
+    return(op - out);
+}
+
+
+/* read the block table of a block-compressed cross-reference, or
+   forget the last one if blocktable is 0 */
+BOOL
+readblocktable(char *file)
+{
+    FILE    *refs;
+    long    i;
+
+    free(blockoffset);
+    blockoffset = NULL;
+    nblocks = 0;
+    if (blocktable == 0) {
+	return(YES);
+    }
+    if ((refs = vpfopen(file, "rb")) == NULL
+	|| fseek(refs, blocktable, SEEK_SET) == -1
+	|| fscanf(refs, "%ld", &nblocks) != 1 || nblocks < 0) {
+	goto bad;
+    }
+    blockoffset = mymalloc((nblocks + 1) * sizeof(*blockoffset));
+    for (i = 0; i <= nblocks; ++i) {
+	if (fscanf(refs, "%ld", &blockoffset[i]) != 1
+	    || (i > 0 && (blockoffset[i] < blockoffset[i - 1]
+			  || blockoffset[i] - blockoffset[i - 1] > PACKMAX))) {
+	    goto bad;
+	}
+    }
+    fclose(refs);
+    return(YES);
+
+bad:
+    posterr("cscope: cannot read the block table in file %s\n", file);
+    if (refs != NULL) {
+	fclose(refs);
+    }
+    free(blockoffset);
+    blockoffset = NULL;
+    nblocks = 0;
+    return(NO);
+}
+
+
+/* read and unpack block n of the cross-reference into buf, returning
+   its size, or 0 after the last block.  The packed block is unpacked
+   where it is in the file's mapping, if it is mapped */
+int
+readpacked(int fd, char *map, long mapsize, long n, char *buf)
+{
+    char    *in = packed;
+    long    size;
+    int     len;
+
+    if (n < 0 || n >= nblocks) {
+	return(0);
+    }
+    size = blockoffset[n + 1] - blockoffset[n];
+    if (map != NULL && blockoffset[n + 1] <= mapsize) {
+	in = map + blockoffset[n];
+    } else if (lseek(fd, blockoffset[n], SEEK_SET) == -1
+	       || read(fd, packed, size) != size) {
+	in = NULL;
+    }
+    if (in == NULL || (len = unpackblock(in, size, buf, BUFSIZ)) < 0) {
+	posterr("cscope: cannot read cross-reference block %ld\n", n);
+	return(0);
+    }
+    return(len);
+}
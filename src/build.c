@@ -42,8 +42,14 @@
 
 #include "library.h"
 #include "alloc.h"
+#include "blocks.h"
+#include "buildstats.h"
+#include "jobs.h"
+#include "postsort.h"
 #include "scanner.h"
-#include "version.h"		/* for FILEVERSION */
+#include "shard.h"
+#include "trigram.h"
+#include "version.h"		/* for FILEVERSION and PACKEDVERSION */
 #include "vp.h"
 
 #if defined(USE_NCURSES) && !defined(RENAMED_NCURSES)
@@ -57,6 +63,10 @@
 BOOL	buildonly = NO;		/* only build the database */
 BOOL	unconditional = NO;	/* unconditionally build database */
 BOOL	fileschanged;		/* assume some files changed */
+long	memorylimit;		/* build memory budget in bytes, or 0 */
+size_t	scanmemory;		/* largest scanner buffer kept, or 0 */
+unsigned long *passstart;	/* first file of each pass of the last build */
+int	npasses;		/* number of them, or 0 if it was up-to-date */
 
 /* variable copies of the master strings... */
 char	invname_buf[] = INVNAME;
@@ -79,18 +89,124 @@ static char *newinvname;	/* new inverted index file name */
 static char *newinvpost;	/* new inverted index postings file name */
 static long traileroffset;	/* file trailer offset */
 
+/* source file stamps, so a file whose status changed but whose contents
+   did not is copied from the old cross-reference */
+#define	STAMPSAME	1	/* file status is the same as the old stamp */
+#define	STAMPMOVED	2	/* status changed, but not the contents */
+#define	STAMPCHANGED	3	/* contents changed, or the file is new */
+#define	NOHASH		0	/* no hash of contents that could be read */
+
+/* cross-reference file version of the database being built */
+#define	DBVERSION	(blockcompress == YES ? PACKEDVERSION : FILEVERSION)
+
+typedef	struct {
+	long	size;		/* file size */
+	long	mtime;		/* modification time */
+	unsigned long inode;	/* inode number */
+	unsigned long long hash; /* hash of the contents, or NOHASH */
+	BOOL	hashed;		/* hash has been formed */
+	int	state;		/* comparison with the old stamp, or 0 */
+} FILESTAMP;
+
+typedef	struct {
+	char	*name;		/* file name */
+	FILESTAMP stamp;
+} OLDSTAMP;
+
+static FILESTAMP *filestamps;	/* stamp of each source file */
+static unsigned long nfilestamps; /* size of filestamps */
+static OLDSTAMP *oldstamps;	/* old cross-reference's stamps by name */
+static unsigned long noldstamps; /* number of old stamps */
+static BOOL	haveoldstamps;	/* old cross-reference has stamps */
+
+/* parallel cross-referencing of the changed files in a pass */
+#define	TASKSPERJOB	4	/* tasks per job, so early finishers help out */
+#define	TERMMAPINC	1024	/* task term map size increment */
+
+static unsigned long *jobfileindex; /* source files for the build jobs */
+static unsigned long *jobtaskstart; /* first jobfileindex entry of each task */
+static int	*filetask;	/* build job task of each file in the pass */
+static unsigned long filetaskbase; /* first file in the pass */
+static int	curtask = -1;	/* task whose output is open */
+static FILE	*taskindex;	/* task's file fragment list */
+static FILE	*taskdata;	/* task's cross-reference */
+static FILE	*taskposts;	/* task's postings */
+static unsigned int jobtermbase; /* posting terms numbered before the jobs */
+static unsigned int *tasktermmap; /* task's term numbers to the build's */
+
+/* incremental inverted index updates.  The postings of files that are
+   new or changed since the inverted index was made go in a small delta
+   index beside it, and the trailer maps each file in the database to
+   its postings in the inverted index, which are moved to where the file
+   now is; postings of files not mapped are ignored */
+#define	DELTARATIO	10	/* merge when over 1 in this many files are in
+				   the delta index */
+
+typedef	struct {
+	long	base;		/* file index in the inverted index, or -1 */
+	long	baseoffset;	/* file name offset when the index was made */
+	long	offset;		/* file name offset in the database */
+} INDEXMAP;
+
+static char *deltainvname;	/* delta inverted index file name */
+static char *deltainvpost;	/* delta inverted index postings file name */
+static BOOL	deltaindex;	/* new postings go in the delta index */
+static INDEXMAP *oldindexmap;	/* old cross-reference's index map */
+static long	noldindexmap;	/* number of files in oldindexmap */
+static long	oldfileindex;	/* file index of getoldfile()'s file */
+static INDEXMAP *indexmap;	/* new cross-reference's index map */
+
+/* the trailer ends with the database offset of each file's name and its
+   symbol and source line counts, so a search can go straight to a file
+   and a rebuild can skip an old file's data */
+SEGMENT	*segments;		/* the database's file segments, or NULL */
+long	nsegments;		/* number of them */
+long	segmentsend;		/* database offset of the empty last name */
+static BOOL	segmentsread;	/* segments read for this database */
+static SEGMENT *oldsegments;	/* old cross-reference's segments */
+static long	noldsegments;	/* number of them */
+static long	oldsegmentsend;	/* its empty last name offset */
+static SEGMENT *newsegments;	/* new cross-reference's segments */
+static long	nnewsegments;	/* number of them */
+static long	mnewsegments;	/* size of newsegments */
+
 
 /* Internal prototypes: */
 static	void	cannotindex(void);
+static	BOOL	opendelta(void);
+static	void	closetask(void);
 static	int	compare(const void *s1, const void *s2);
+static	int	comparestamps(const void *s1, const void *s2);
 static	void	copydata(void);
 static	void	copyinverted(void);
+static	void	crossreffile(unsigned long fileindex);
+static	void	crossrefjobs(unsigned long firstfile, unsigned long lastfile,
+			     time_t reftime);
+static	BOOL	crossreftask(int task, void *arg);
+static	void	endcrossrefjobs(void);
+static	void	freestamps(void);
+static	BOOL	getnumbers(FILE *refs, long *values, int count);
 static	char	*getoldfile(void);
+static	SEGMENT	*getsegments(FILE *refs, long *count, long *end);
+static	void	growindexmap(unsigned long count);
+static	BOOL	hashfile(char *file, unsigned long long *hash);
 static	void	movefile(char *new, char *old);
+static	void	packrefs(char *dir);
 static	void	putheader(char *dir);
 static	void	fetch_include_from_dbase(char *, size_t);
+static	void	putindexmap(void);
 static	void	putlist(char **names, int count);
+static	void	putsegment(unsigned long fileindex, long start);
+static	void	putsegments(long end);
+static	void	putstamps(time_t reftime);
+static	BOOL	readoldstamps(FILE *oldrefs);
+static	INDEXMAP *readindexmap(FILE *refs, long *count);
+static	unsigned int *readtaskterms(int task);
 static	BOOL	samelist(FILE *oldrefs, char **names, int count);
+static	void	setup_delta_filenames(void);
+static	BOOL	skiplines(FILE *refs, unsigned long count);
+static	BOOL	skiptrailer(FILE *refs);
+static	int	stampfile(unsigned long fileindex, time_t reftime);
 
 
 /* Error handling routine if inverted index creation fails */
@@ -140,6 +256,8 @@ void setup_build_filenames(char *reffile)
     char *path;			/* file pathname */
     char *s;			/* pointer to basename in path */
 
+    /* forget the names for any other cross-reference */
+    free_newbuildfiles();
     path = mymalloc(strlen(reffile) + 10u);
     strcpy(path, reffile);
     s = mybasename(path);
@@ -155,6 +273,31 @@ void setup_build_filenames(char *reffile)
     free(path);
 }
 
+/* Set up the delta inverted index file names, "d" prefixed like the
+   "n" prefixed new ones */
+static void
+setup_delta_filenames(void)
+{
+    char *path;
+    char *s;
+
+    if (deltainvname != NULL) {
+	return;
+    }
+    path = mymalloc(strlen(invname) + strlen(invpost) + 2);
+    strcpy(path, invname);
+    s = mybasename(path);
+    *s = 'd';
+    strcpy(s + 1, mybasename(invname));
+    deltainvname = my_strdup(path);
+    strcpy(path, invpost);
+    s = mybasename(path);
+    *s = 'd';
+    strcpy(s + 1, mybasename(invpost));
+    deltainvpost = my_strdup(path);
+    free(path);
+}
+
 /* open the database */
 
 void
@@ -164,7 +307,16 @@ opendatabase(void)
 	cannotopen(reffile);
 	myexit(1);
     }
+    mapdatabase();
     blocknumber = -1;	/* force next seek to read the first block */
+    if (readblocktable(reffile) == NO) {
+	myexit(1);
+    }
+    /* its segments are read by the first search that needs them */
+    free(segments);
+    segments = NULL;
+    nsegments = 0;
+    segmentsread = NO;
 	
     /* open any inverted index */
     if (invertedindex == YES &&
@@ -172,6 +324,95 @@ opendatabase(void)
 	askforreturn();		/* so user sees message */
 	invertedindex = NO;
     }
+    /* and any delta index, with the map of where the inverted index
+       postings now are in the database */
+    if (invertedindex == YES && opendelta() == NO) {
+	invclose(&invcontrol);
+	askforreturn();		/* so user sees message */
+	invertedindex = NO;
+    }
+}
+
+/* read the cross-reference's inverted index map and open the delta
+   index it needs */
+static BOOL
+opendelta(void)
+{
+    FILE    *refs;
+    INDEXMAP *map;
+    long    nmap;
+    long    *filemap;
+    long    *fileshift;
+    long    nbase = 0;
+    long    i;
+    BOOL    moved = NO;
+    BOOL    ok = YES;
+
+    if ((refs = vpfopen(reffile, "rb")) == NULL) {
+	cannotopen(reffile);
+	return(NO);
+    }
+    map = NULL;
+    if (fseek(refs, traileroffset, SEEK_SET) != -1 && skiptrailer(refs) == YES) {
+	map = readindexmap(refs, &nmap);
+    }
+    fclose(refs);
+
+    /* a database written before the map, or with a newly made inverted
+       index, needs none */
+    if (map == NULL) {
+	return(YES);
+    }
+    for (i = 0; i < nmap; ++i) {
+	if (map[i].base != i || map[i].offset != map[i].baseoffset) {
+	    moved = YES;
+	}
+	if (map[i].base >= nbase) {
+	    nbase = map[i].base + 1;
+	}
+    }
+    if (moved == NO) {
+	free(map);
+	return(YES);
+    }
+    filemap = mymalloc((nbase + 1) * sizeof(*filemap));
+    fileshift = mymalloc((nbase + 1) * sizeof(*fileshift));
+    for (i = 0; i < nbase; ++i) {
+	filemap[i] = -1;
+	fileshift[i] = 0;
+    }
+    for (i = 0; i < nmap; ++i) {
+	if (map[i].base >= 0) {
+	    filemap[map[i].base] = i;
+	    fileshift[map[i].base] = map[i].offset - map[i].baseoffset;
+	}
+    }
+    free(map);
+    setup_delta_filenames();
+    if (access(deltainvname, READ) == 0) {
+	ok = invdelta(&invcontrol, deltainvname, deltainvpost,
+		      filemap, fileshift, nbase) != -1;
+    } else {
+	(void) invdelta(&invcontrol, NULL, NULL, filemap, fileshift, nbase);
+    }
+    return(ok);
+}
+
+/* open the inverted index and any delta index, so all the terms that
+   a search can find are walked through, returning NO if there is none */
+BOOL
+opentermindex(INVCONTROL *invcntl)
+{
+    if (invopen(invcntl, invname, invpost, INVAVAIL) == -1) {
+	return(NO);
+    }
+    setup_delta_filenames();
+    if (access(deltainvname, READ) == 0
+	&& invdelta(invcntl, deltainvname, deltainvpost, NULL, NULL, 0) == -1) {
+	invclose(invcntl);
+	return(NO);
+    }
+    return(YES);
 }
 
 
@@ -179,14 +420,21 @@ opendatabase(void)
 void
 rebuild(void)
 {
-    close(symrefs);
-    if (invertedindex == YES) {
-	invclose(&invcontrol);
-	nsrcoffset = 0;
-	npostings = 0;
+    if (sharded == YES) {
+	buildshards();
+	putbuildstats();
+    } else {
+	unmapdatabase();
+	close(symrefs);
+	if (invertedindex == YES) {
+	    invclose(&invcontrol);
+	    nsrcoffset = 0;
+	    npostings = 0;
+	}
+	build();
+	putbuildstats();
+	opendatabase();
     }
-    build();
-    opendatabase();
 
     /* revert to the initial display */
     if (refsfound != NULL) {
@@ -216,6 +464,10 @@ build(void)
     int     copied = 0;		/* copied crossref for these files */
     unsigned long fileindex;		/* source file name index */
     BOOL    interactive = YES;	/* output progress messages */
+    STATTIME statstart;		/* start of a timed build phase */
+    long    statbytes;		/* database offset at its start */
+    long    terms;		/* inverted index terms */
+    long    segstart;		/* database offset of a file's data */
 
     /* normalize the current directory relative to the home directory so
        the cross-reference is not rebuilt when the user's login is moved */
@@ -227,6 +479,7 @@ build(void)
     }
     /* sort the source file names (needed for rebuilding) */
     qsort(srcfiles, nsrcfiles, sizeof(*srcfiles), compare);
+    npasses = 0;
 
     /* if there is an old cross-reference and its current directory matches */
     /* or this is an unconditional build */
@@ -242,9 +495,11 @@ build(void)
 	    BOOL	oldcompress = YES;
 	    BOOL	oldinvertedindex = NO;
 	    BOOL	oldtruncate = NO;
+	    BOOL	oldblockcompress = NO;
 	    int	c;
 
 	    /* see if there are options in the database */
+	    blocktable = 0;
 	    for (;;) {
 		while((c = getc(oldrefs)) == ' ')
 		    ; 		/* do nothing */
@@ -263,12 +518,22 @@ build(void)
 		case 'T':	/* truncate symbols to 8 characters */
 		    oldtruncate = YES;
 		    break;
+		case 'z':	/* block-compressed */
+		    oldblockcompress = YES;
+		    fscanf(oldrefs, "%ld", &blocktable);
+		    break;
 		}
 	    }
 	    /* check the old and new option settings */
-	    if (oldcompress != compress || oldtruncate != trun_syms) {
+	    if (oldcompress != compress || oldtruncate != trun_syms
+		|| oldblockcompress != blockcompress) {
 		posterr("\
-cscope: -c or -T option mismatch between command line and old symbol database\n");
+cscope: -c, -T or -z option mismatch between command line and old symbol database\n");
+		goto force;
+	    }
+	    /* get the trailer offset */
+	    if (fscanf(oldrefs, "%ld", &traileroffset) != 1) {
+		posterr("cscope: incorrect symbol database file format\n");
 		goto force;
 	    }
 	    if (oldinvertedindex != invertedindex) {
@@ -279,15 +544,25 @@ cscope: -q option mismatch between command line and old symbol database\n");
 			    invname, invpost);
 		    unlink(invname);
 		    unlink(invpost);
+		    setup_delta_filenames();
+		    unlink(deltainvname);
+		    unlink(deltainvpost);
 		}
 		goto outofdate;
 	    }
 	    /* seek to the trailer */
-	    if (fscanf(oldrefs, "%ld", &traileroffset) != 1 ||
-		fseek(oldrefs, traileroffset, SEEK_SET) == -1) {
+	    if (fseek(oldrefs, traileroffset, SEEK_SET) == -1) {
 		posterr("cscope: incorrect symbol database file format\n");
 		goto force;
 	    }
+	    /* get the old file stamps and return to the trailer */
+	    if (fileversion == DBVERSION) {
+		haveoldstamps = readoldstamps(oldrefs);
+		if (haveoldstamps == YES && oldinvertedindex == YES) {
+		    oldindexmap = readindexmap(oldrefs, &noldindexmap);
+		}
+		fseek(oldrefs, traileroffset, SEEK_SET);
+	    }
 	}
 	/* if assuming that some files have changed */
 	if (fileschanged == YES) {
@@ -307,8 +582,7 @@ cscope: -q option mismatch between command line and old symbol database\n");
 	for (i = 0; i < nsrcfiles; ++i) {
 	    if ((1 != fscanf(oldrefs," %[^\n]",oldname))
 		|| strnotequal(oldname, srcfiles[i])
-		|| (lstat(srcfiles[i], &statstruct) != 0)
-		|| (statstruct.st_mtime > reftime)
+		|| stampfile(i, reftime) != STAMPSAME
 		) {
 		goto outofdate;
 	    }
@@ -319,24 +593,43 @@ cscope: -q option mismatch between command line and old symbol database\n");
 	    addsrcfile(oldname);
 	}
 	fclose(oldrefs);
+	freestamps();
+	free(oldindexmap);
+	oldindexmap = NULL;
+	if (trigramindex == YES && sharded == NO) {
+	    buildtrigrams();
+	}
 	return;
 		
     outofdate:
 	/* if the database format has changed, rebuild it all */
-	if (fileversion != FILEVERSION) {
+	if (fileversion != DBVERSION) {
 	    fprintf(stderr, "\
 cscope: converting to new symbol database file format\n");
 	    goto force;
 	}
+	/* get the old files' segments, whose counts are copied with their
+	   data */
+	if (fseek(oldrefs, traileroffset, SEEK_SET) == -1
+	    || skiptrailer(oldrefs) == NO
+	    || (oldsegments = getsegments(oldrefs, &noldsegments,
+					  &oldsegmentsend)) == NULL) {
+	    goto force;
+	}
 	/* reopen the old cross-reference file for fast scanning */
+	if (readblocktable(reffile) == NO) {
+	    goto force;
+	}
 	if ((symrefs = vpopen(reffile, O_BINARY | O_RDONLY)) == -1) {
 	    postfatal("cscope: cannot open file %s\n", reffile);
 	    /* NOTREACHED */
 	}
+	mapdatabase();
 	/* get the first file name in the old cross-reference */
 	blocknumber = -1;
 	read_block();	/* read the first cross-ref block */
 	scanpast('\t');	/* skip the header */
+	oldfileindex = -1;
 	oldfile = getoldfile();
     } else {	/* force cross-referencing of all the source files */
     force:	
@@ -352,8 +645,30 @@ cscope: converting to new symbol database file format\n");
 	cannotwrite(temp1);
 	cannotindex();
     }
+    /* if few files are new or changed, leave the inverted index as it
+       is and put their postings in the delta index */
+    deltaindex = NO;
+    if (invertedindex == YES && oldindexmap != NULL && oldfile != NULL
+	&& access(invname, READ) == 0 && access(invpost, READ) == 0) {
+	unsigned long ndelta = 0;
+
+	for (i = 0; i < (unsigned long) noldindexmap; ++i) {
+	    if (oldindexmap[i].base < 0) {
+		++ndelta;
+	    }
+	}
+	for (i = 0; i < nsrcfiles; ++i) {
+	    if (stampfile(i, reftime) == STAMPCHANGED) {
+		++ndelta;
+	    }
+	}
+	if (ndelta * DELTARATIO <= nsrcfiles) {
+	    deltaindex = YES;
+	}
+    }
     putheader(newdir);
-    fileversion = FILEVERSION;
+    fileversion = DBVERSION;
+    nnewsegments = 0;
     if (buildonly == YES && verbosemode != YES && !isatty(0)) {
 	interactive = NO;
     } else {
@@ -363,18 +678,30 @@ cscope: converting to new symbol database file format\n");
     dbputc('\t');
 
     /* make passes through the source file list until the last level of
-       included files is processed */
+       included files is processed, looking for each #include afresh */
+    freeincludes();
     firstfile = 0;
     lastfile = nsrcfiles;
     if (invertedindex == YES) {
 	srcoffset = mymalloc((nsrcfiles + 1u) * sizeof(*srcoffset));
+	if (deltaindex == YES) {
+	    growindexmap(nsrcfiles + 1u);
+	}
     }
     for (;;) {
+	passstart = myrealloc(passstart, (npasses + 1) * sizeof(*passstart));
+	passstart[npasses++] = firstfile;
 	progress("Building symbol database", (long)built,
 		 (long)lastfile);
 	if (linemode == NO)
 	    refresh();
 
+	/* cross-reference the changed files in parallel */
+	if (njobs > 1) {
+	    stattime(&statstart);
+	    crossrefjobs(firstfile, lastfile, reftime);
+	    statphase(STATCROSSREF, &statstart, 0, 0);
+	}
 	/* get the next source file name */
 	for (fileindex = firstfile; fileindex < lastfile; ++fileindex) {
 			
@@ -384,17 +711,17 @@ cscope: converting to new symbol database file format\n");
 	    }
 	    /* if the old file has been deleted get the next one */
 	    file = srcfiles[fileindex];
+	    segstart = dboffset;
 	    while (oldfile != NULL && strcmp(file, oldfile) > 0) {
 		oldfile = getoldfile();
 	    }
 	    /* if there isn't an old database or this is a new file */
 	    if (oldfile == NULL || strcmp(file, oldfile) < 0) {
-		crossref(file);
+		crossreffile(fileindex);
 		++built;
-	    } else if (lstat(file, &statstruct) == 0
-		       && statstruct.st_mtime > reftime) {
+	    } else if (stampfile(fileindex, reftime) == STAMPCHANGED) {
 		/* if this file was modified */
-		crossref(file);
+		crossreffile(fileindex);
 		++built;
 				
 		/* skip its old crossref so modifying the last source
@@ -405,16 +732,29 @@ cscope: converting to new symbol database file format\n");
 		oldfile = getoldfile();
 	    } else {	
 		/* copy its cross-reference */
+		stattime(&statstart);
+		statbytes = dboffset;
 		putfilename(file);
-		if (invertedindex == YES) {
+		if (deltaindex == YES && oldfileindex < noldindexmap
+		    && oldindexmap[oldfileindex].base >= 0) {
+		    /* its postings are still in the inverted index */
+		    copydata();
+		    indexmap[nsrcoffset - 1] = oldindexmap[oldfileindex];
+		} else if (invertedindex == YES) {
 		    copyinverted();
 		} else {
 		    copydata();
 		}
+		filesymbols = oldsegments[oldfileindex].symbols;
+		filelines = oldsegments[oldfileindex].lines;
+		statphase(STATCOPY, &statstart, dboffset - statbytes, 1);
 		++copied;
 		oldfile = getoldfile();
 	    }
+	    putsegment(fileindex, segstart);
 	}
+	endcrossrefjobs();
+
 	/* see if any included files were found */
 	if (lastfile == nsrcfiles) {
 	    break;
@@ -423,11 +763,15 @@ cscope: converting to new symbol database file format\n");
 	lastfile = nsrcfiles;
 	if (invertedindex == YES) {
 	    srcoffset = myrealloc(srcoffset, (nsrcfiles + 1) * sizeof(*srcoffset));
+	    if (deltaindex == YES) {
+		growindexmap(nsrcfiles + 1);
+	    }
 	}
 	/* sort the included file names */
 	qsort(srcfiles + firstfile, lastfile - firstfile, sizeof(*srcfiles), compare);
     }
     /* add a null file name to the trailing tab */
+    segstart = dboffset;
     putfilename("");
     dbputc('\n');
 	
@@ -438,6 +782,16 @@ cscope: converting to new symbol database file format\n");
     putlist(srcdirs, nsrcdirs);
     putlist(incdirs, nincdirs);
     putlist(srcfiles, nsrcfiles);
+    putstamps(reftime);
+    freestamps();
+    putindexmap();
+    putsegments(segstart + 1);
+    free(oldindexmap);
+    oldindexmap = NULL;
+    noldindexmap = 0;
+    free(oldsegments);
+    oldsegments = NULL;
+    noldsegments = 0;
     if (fflush(newrefs) == EOF) {
 	/* rewind doesn't check for write failure */
 	cannotwrite(newreffile);
@@ -446,37 +800,58 @@ cscope: converting to new symbol database file format\n");
 
     /* create the inverted index if requested */
     if (invertedindex == YES) {
-	char	sortcommand[PATHLEN + 1];
-
-	if (fflush(postings) == EOF) {
+	if (fclose(postings) == EOF) {
 	    cannotwrite(temp1);
 	    /* NOTREACHED */
 	}
-	fstat(fileno(postings), &statstruct);
-	fclose(postings);
-	snprintf(sortcommand, sizeof(sortcommand), "env LC_ALL=C sort -T %s %s", tmpdir, temp1);
-	if ((postings = mypopen(sortcommand, "r")) == NULL) {
-	    fprintf(stderr, "cscope: cannot open pipe to sort command\n");
+	setup_delta_filenames();
+	stattime(&statstart);
+	if (sortpostings(temp1) == NO) {
+	    fprintf(stderr, "cscope: cannot sort the inverted index postings\n");
 	    cannotindex();
 	} else {
-	    if ((totalterms = invmake(newinvname, newinvpost, postings)) > 0) {
-		movefile(newinvname, invname);
-		movefile(newinvpost, invpost);
+	    statphase(STATSORT, &statstart,
+		      npostings * (long) sizeof(TEMPPOSTING), npostings);
+	    stattime(&statstart);
+	    if (deltaindex == YES && npostings == 0) {
+		unlink(deltainvname);
+		unlink(deltainvpost);
+	    } else if ((terms = invmake(newinvname, newinvpost, nextposting)) > 0) {
+		statphase(STATINVMAKE, &statstart, invbytes, invterms);
+		if (deltaindex == YES) {
+		    /* the header keeps the inverted index's term count */
+		    movefile(newinvname, deltainvname);
+		    movefile(newinvpost, deltainvpost);
+		} else {
+		    totalterms = terms;
+		    movefile(newinvname, invname);
+		    movefile(newinvpost, invpost);
+		    unlink(deltainvname);
+		    unlink(deltainvpost);
+		}
 	    } else {
 		cannotindex();
 	    }
-	    mypclose(postings);
 	}
+	endsortpostings();
+	freeterms();
 	unlink(temp1);
 	free(srcoffset);
+	free(indexmap);
+	indexmap = NULL;
     }
     /* rewrite the header with the trailer offset and final option list */
+    blocktable = 0;
     rewind(newrefs);
     putheader(newdir);
     fclose(newrefs);
+    if (blockcompress == YES) {
+	packrefs(newdir);
+    }
 	
     /* close the old database file */
     if (symrefs >= 0) {
+	unmapdatabase();
 	close(symrefs);
     }
     if (oldrefs != NULL) {
@@ -484,9 +859,280 @@ cscope: converting to new symbol database file format\n");
     }
     /* replace it with the new database file */
     movefile(newreffile, reffile);
+
+    /* index the source files' text for searches */
+    if (trigramindex == YES && sharded == NO) {
+	buildtrigrams();
+    }
 }
 	
 
+/* cross-reference the files in this pass that are new or changed since
+   the old cross-reference in parallel build jobs; each job's output is
+   copied into the new database by crossreffile() in file order, so the
+   database is the same as one built serially */
+
+static void
+crossrefjobs(unsigned long firstfile, unsigned long lastfile, time_t reftime)
+{
+    unsigned long i, n;
+    long    *filesize;		/* sizes of the files to cross-reference */
+    long    totalsize = 0;
+    long    tasksize;		/* bytes of source per task */
+    long    size;
+    int     ntasks;
+    int     task;
+    FILE    *incs;		/* task's #included files */
+    char    name[PATHLEN + 1];
+
+    jobfileindex = mymalloc((lastfile - firstfile) * sizeof(*jobfileindex));
+    filesize = mymalloc((lastfile - firstfile) * sizeof(*filesize));
+    for (n = 0, i = firstfile; i < lastfile; ++i) {
+	if (stampfile(i, reftime) == STAMPCHANGED) {
+	    jobfileindex[n] = i;
+	    filesize[n++] = filestamps[i].size;
+	    totalsize += filestamps[i].size;
+	}
+    }
+    if (n < 2) {
+	goto done;
+    }
+    /* split the files into tasks of about the same amount of source */
+    tasksize = totalsize / (njobs * TASKSPERJOB) + 1;
+    jobtaskstart = mymalloc((n + 1) * sizeof(*jobtaskstart));
+    for (ntasks = 0, size = 0, i = 0; i < n; ++i) {
+	if (size == 0) {
+	    jobtaskstart[ntasks++] = i;
+	}
+	if ((size += filesize[i] + 1) >= tasksize) {
+	    size = 0;
+	}
+    }
+    jobtaskstart[ntasks] = n;
+
+    filetaskbase = firstfile;
+    filetask = mymalloc((lastfile - firstfile) * sizeof(*filetask));
+    for (i = 0; i < lastfile - firstfile; ++i) {
+	filetask[i] = -1;
+    }
+    for (task = 0; task < ntasks; ++task) {
+	for (i = jobtaskstart[task]; i < jobtaskstart[task + 1]; ++i) {
+	    filetask[jobfileindex[i] - firstfile] = task;
+	}
+    }
+    jobtermbase = nterms;
+    if (runjobs(ntasks, crossreftask, NULL) == NO) {
+	posterr("cscope: parallel build failed, cross-referencing serially\n");
+	endcrossrefjobs();
+	goto done;
+    }
+    /* add the #included files the jobs found */
+    for (task = 0; task < ntasks; ++task) {
+	if ((incs = myfopen(jobfile(task, ".i"), "r")) == NULL) {
+	    continue;
+	}
+	while (fgets(name, sizeof(name), incs) != NULL) {
+	    name[strcspn(name, "\n")] = '\0';
+	    if (infilelist(name) == NO) {
+		addsrcfile(name);
+	    }
+	}
+	fclose(incs);
+    }
+ done:
+    free(jobfileindex);
+    free(jobtaskstart);
+    free(filesize);
+    jobfileindex = NULL;
+    jobtaskstart = NULL;
+}
+
+
+/* build job task: cross-reference a range of files, writing each file's
+   cross-reference and postings as if it started at database offset 0 */
+
+static BOOL
+crossreftask(int task, void *arg)
+{
+    FILE    *index;		/* file fragment list */
+    FILE    *incs;		/* #included files found */
+    FILE    *termfile;		/* posting terms numbered by the job */
+    FRAGMENT frag;
+    unsigned long i;
+    unsigned long oldnsrcfiles = nsrcfiles;
+    unsigned int term;
+    long    postoffset = 0;
+    BOOL    ok = YES;
+    STATTIME start;
+
+    (void) arg;
+    if ((index = myfopen(jobfile(task, ".x"), "wb")) == NULL
+	|| (newrefs = myfopen(jobfile(task, ".d"), "wb")) == NULL
+	|| (postings = myfopen(jobfile(task, ".p"), "wb")) == NULL
+	|| (incs = myfopen(jobfile(task, ".i"), "w")) == NULL
+	|| (termfile = myfopen(jobfile(task, ".t"), "wb")) == NULL) {
+	return(NO);
+    }
+    for (i = jobtaskstart[task]; i < jobtaskstart[task + 1]; ++i) {
+	frag.fileindex = jobfileindex[i];
+	dboffset = 0;
+	nsrcoffset = 0;
+	npostings = 0;
+	errorsfound = NO;
+	stattime(&start);
+	crossref(srcfiles[frag.fileindex]);
+	frag.seconds = statphase(STATCROSSREF, &start, 0, 1);
+	frag.size = dboffset;
+	frag.postsize = ftell(postings) - postoffset;
+	postoffset += frag.postsize;
+	frag.npostings = npostings;
+	frag.nameoffset = nsrcoffset > 0 ? srcoffset[0] : -1;
+	frag.errors = errorsfound;
+	frag.symbols = filesymbols;
+	frag.lines = filelines;
+	if (fwrite(&frag, sizeof(frag), 1, index) != 1) {
+	    ok = NO;
+	    break;
+	}
+    }
+    /* pass on the #included files this task added to the file list */
+    for (i = oldnsrcfiles; i < nsrcfiles; ++i) {
+	fprintf(incs, "%s\n", srcfiles[i]);
+    }
+    /* and the names of the posting terms this job numbered */
+    for (term = jobtermbase; term < nterms; ++term) {
+	fputs(posttermname(term), termfile);
+	putc('\0', termfile);
+    }
+    if (fclose(index) == EOF || fclose(newrefs) == EOF
+	|| fclose(postings) == EOF || fclose(incs) == EOF
+	|| fclose(termfile) == EOF) {
+	ok = NO;
+    }
+    return(ok);
+}
+
+
+/* cross-reference a file, or copy its cross-reference from the build
+   job that did it */
+
+static void
+crossreffile(unsigned long fileindex)
+{
+    FRAGMENT frag;
+    int     task;
+    STATTIME start;
+
+    stattime(&start);
+
+    if (filetask != NULL
+	&& (task = filetask[fileindex - filetaskbase]) >= 0) {
+	if (task != curtask) {
+	    closetask();
+	    curtask = task;
+	    taskindex = myfopen(jobfile(task, ".x"), "rb");
+	    taskdata = myfopen(jobfile(task, ".d"), "rb");
+	    taskposts = myfopen(jobfile(task, ".p"), "rb");
+	    tasktermmap = readtaskterms(task);
+	}
+	while (taskindex != NULL && taskdata != NULL && taskposts != NULL
+	       && tasktermmap != NULL
+	       && fread(&frag, sizeof(frag), 1, taskindex) == 1) {
+	    if (frag.fileindex == fileindex) {
+		putfragment(&frag, taskdata, taskposts, tasktermmap);
+		if (frag.errors == YES) {
+		    errorsfound = YES;
+		}
+		statphase(STATCROSSREF, &start, 0, 1);
+		statfile(srcfiles[fileindex], frag.seconds);
+		return;
+	    }
+	    /* skip a file that turned out not to need cross-referencing */
+	    fseek(taskdata, frag.size, SEEK_CUR);
+	    fseek(taskposts, frag.postsize, SEEK_CUR);
+	}
+    }
+    crossref(srcfiles[fileindex]);
+    statfile(srcfiles[fileindex], statphase(STATCROSSREF, &start, 0, 1));
+}
+
+
+/* map a build job task's posting term numbers to this build's */
+
+static unsigned int *
+readtaskterms(int task)
+{
+    FILE    *termfile;
+    unsigned int *map;
+    unsigned int maxmap = jobtermbase + TERMMAPINC;
+    unsigned int n;
+    char    *name = NULL;
+    size_t  size = 0;
+    size_t  len = 0;
+    int     c;
+
+    if ((termfile = myfopen(jobfile(task, ".t"), "rb")) == NULL) {
+	return(NULL);
+    }
+    /* the terms numbered before the jobs started keep their numbers */
+    map = mymalloc(maxmap * sizeof(*map));
+    for (n = 0; n < jobtermbase; ++n) {
+	map[n] = n;
+    }
+    while ((c = getc(termfile)) != EOF) {
+	if (len == size) {
+	    name = myrealloc(name, size += PATLEN);
+	}
+	name[len++] = c;
+	if (c == '\0') {
+	    if (n == maxmap) {
+		map = myrealloc(map, (maxmap *= 2) * sizeof(*map));
+	    }
+	    map[n++] = postterm(name);
+	    len = 0;
+	}
+    }
+    fclose(termfile);
+    free(name);
+    return(map);
+}
+
+
+/* close the output of the current build job task */
+
+static void
+closetask(void)
+{
+    if (taskindex != NULL) {
+	fclose(taskindex);
+    }
+    if (taskdata != NULL) {
+	fclose(taskdata);
+    }
+    if (taskposts != NULL) {
+	fclose(taskposts);
+    }
+    free(tasktermmap);
+    taskindex = taskdata = taskposts = NULL;
+    tasktermmap = NULL;
+    curtask = -1;
+}
+
+
+/* discard the build jobs' output at the end of a pass */
+
+static void
+endcrossrefjobs(void)
+{
+    if (filetask != NULL) {
+	closetask();
+	free(filetask);
+	filetask = NULL;
+	removejobfiles();
+    }
+}
+
+
 /* string comparison function for qsort */
 static int
 compare(const void *arg_s1, const void *arg_s2)
@@ -498,6 +1144,17 @@ compare(const void *arg_s1, const void *arg_s2)
 }
 
 
+/* old file stamp name comparison function for qsort and bsearch */
+static int
+comparestamps(const void *arg_s1, const void *arg_s2)
+{
+    const OLDSTAMP *s1 = (const OLDSTAMP *) arg_s1;
+    const OLDSTAMP *s2 = (const OLDSTAMP *) arg_s2;
+
+    return(strcmp(s1->name, s2->name));
+}
+
+
 /* seek to the trailer, in a given file */
 void 
 seek_to_trailer(FILE *f) 
@@ -519,12 +1176,21 @@ getoldfile(void)
 {
     static char	file[PATHLEN + 1];	/* file name in old crossref */
 
+    /* go straight to the next file name */
+    if (oldsegments != NULL) {
+	if (oldfileindex + 1 < noldsegments) {
+	    (void) dbseek(oldsegments[oldfileindex + 1].offset - 1);
+	} else {
+	    (void) dbseek(oldsegmentsend - 1);
+	}
+    }
     if (blockp != NULL) {
 	do {
 	    if (*blockp == NEWFILE) {
 		skiprefchar();
 		fetch_string_from_dbase(file, sizeof(file));
 		if (file[0] != '\0') {	/* if not end-of-crossref */
+		    ++oldfileindex;
 		    return(file);
 		}
 		return(NULL);
@@ -541,6 +1207,10 @@ void free_newbuildfiles(void)
     free(newinvname);
     free(newinvpost);
     free(newreffile);
+    free(deltainvname);
+    free(deltainvpost);
+    newinvname = newinvpost = newreffile = NULL;
+    deltainvname = deltainvpost = NULL;
 }	
 
 
@@ -549,7 +1219,7 @@ void free_newbuildfiles(void)
 static void
 putheader(char *dir)
 {
-    dboffset = fprintf(newrefs, "cscope %d %s", FILEVERSION, dir);
+    dboffset = fprintf(newrefs, "cscope %d %s", DBVERSION, dir);
     if (compress == NO) {
 	dboffset += fprintf(newrefs, " -c");
     }
@@ -564,6 +1234,9 @@ putheader(char *dir)
     if (trun_syms == YES) {
 	dboffset += fprintf(newrefs, " -T");
     }
+    if (blockcompress == YES) {
+	dboffset += fprintf(newrefs, " -z %.10ld", blocktable);
+    }
 
     dboffset += fprintf(newrefs, " %.10ld\n", traileroffset);
 #ifdef PRINTF_RETVAL_BROKEN
@@ -572,6 +1245,70 @@ putheader(char *dir)
 }
 
 
+/* pack the new cross-reference into compressed blocks, followed by
+   their offsets and the unchanged trailer, and rewrite its header with
+   where they are */
+static void
+packrefs(char *dir)
+{
+    FILE    *refs;		/* new cross-reference */
+    char    *packedfile;	/* packed new cross-reference */
+    char    in[BUFSIZ];		/* block of the cross-reference */
+    char    out[PACKMAX];	/* packed block */
+    long    *offsets;		/* packed block offsets */
+    long    nblocks, i;
+    long    end = traileroffset; /* end of the blocks */
+    size_t  n;
+
+    packedfile = my_strdup(newreffile);
+    *mybasename(packedfile) = 'z';
+    if ((refs = myfopen(newreffile, "rb")) == NULL
+	|| (newrefs = myfopen(packedfile, "wb")) == NULL) {
+	postfatal("cscope: cannot open file %s\n", packedfile);
+	/* NOTREACHED */
+    }
+    /* the header is rewritten when the offsets are known */
+    putheader(dir);
+    nblocks = (end + BUFSIZ - 1) / BUFSIZ;
+    offsets = mymalloc((nblocks + 1) * sizeof(*offsets));
+    for (i = 0; i < nblocks; ++i) {
+	n = end - i * BUFSIZ < BUFSIZ ? end - i * BUFSIZ : BUFSIZ;
+	if (fread(in, 1, n, refs) != n) {
+	    postfatal("cscope: cannot read file %s\n", newreffile);
+	    /* NOTREACHED */
+	}
+	offsets[i] = ftell(newrefs);
+	fwrite(out, 1, packblock(in, n, out), newrefs);
+    }
+    offsets[nblocks] = ftell(newrefs);
+
+    /* output the block table and copy the trailer */
+    blocktable = offsets[nblocks];
+    fprintf(newrefs, "%ld\n", nblocks);
+    for (i = 0; i <= nblocks; ++i) {
+	fprintf(newrefs, "%ld\n", offsets[i]);
+    }
+    traileroffset = ftell(newrefs);
+    while ((n = fread(in, 1, sizeof(in), refs)) > 0) {
+	fwrite(in, 1, n, newrefs);
+    }
+    if (fflush(newrefs) == EOF || ferror(refs)) {
+	cannotwrite(packedfile);
+	/* NOTREACHED */
+    }
+    rewind(newrefs);
+    putheader(dir);
+    if (fclose(newrefs) == EOF) {
+	cannotwrite(packedfile);
+	/* NOTREACHED */
+    }
+    fclose(refs);
+    movefile(packedfile, newreffile);
+    free(packedfile);
+    free(offsets);
+}
+
+
 /* put the name list into the cross-reference file */
 static void
 putlist(char **names, int count)
@@ -597,20 +1334,484 @@ putlist(char **names, int count)
 }
 
 
+/* put the source file stamps, in file list order, into the
+   cross-reference file, hashing the files not hashed yet.  A file that
+   cannot be read gets no hash, so it is taken to have changed */
+static void
+putstamps(time_t reftime)
+{
+    FILESTAMP *fs;
+    unsigned long i;
+
+    fprintf(newrefs, "%lu\n", nsrcfiles);
+    for (i = 0; i < nsrcfiles; ++i) {
+	(void) stampfile(i, reftime);
+	fs = &filestamps[i];
+	if (fs->hashed == NO) {
+	    if (hashfile(srcfiles[i], &fs->hash) == NO) {
+		fs->hash = NOHASH;
+	    }
+	    fs->hashed = YES;
+	}
+	if (fprintf(newrefs, "%ld %ld %lu %llx\n", fs->size, fs->mtime,
+		    fs->inode, fs->hash) < 0) {
+	    cannotwrite(newreffile);
+	    /* NOTREACHED */
+	}
+    }
+}
+
+
+/* read the source file stamps that follow the file lists in the old
+   cross-reference trailer */
+static BOOL
+readoldstamps(FILE *oldrefs)
+{
+    char    name[PATHLEN + 1];
+    FILESTAMP *fs;
+    unsigned long count;
+    unsigned long i;
+    int     list;
+
+    freestamps();
+
+    /* skip the source and include directory lists */
+    for (list = 0; list < 2; ++list) {
+	if (fscanf(oldrefs, "%lu", &count) != 1) {
+	    return(NO);
+	}
+	for (i = 0; i < count; ++i) {
+	    if (fscanf(oldrefs, " %[^\n]", name) != 1) {
+		return(NO);
+	    }
+	}
+    }
+    /* get the source file names, skipping the string space size */
+    if (fscanf(oldrefs, "%lu %*s", &count) != 1) {
+	return(NO);
+    }
+    oldstamps = mymalloc((count + 1) * sizeof(*oldstamps));
+    for (noldstamps = 0; noldstamps < count; ++noldstamps) {
+	if (fscanf(oldrefs, " %[^\n]", name) != 1) {
+	    freestamps();
+	    return(NO);
+	}
+	oldstamps[noldstamps].name = my_strdup(name);
+    }
+    /* a database written before stamps were added ends here */
+    if (fscanf(oldrefs, "%lu", &i) != 1 || i != count) {
+	freestamps();
+	return(NO);
+    }
+    for (i = 0; i < count; ++i) {
+	fs = &oldstamps[i].stamp;
+	if (fscanf(oldrefs, "%ld %ld %lu %llx", &fs->size, &fs->mtime,
+		   &fs->inode, &fs->hash) != 4) {
+	    freestamps();
+	    return(NO);
+	}
+	fs->hashed = YES;
+    }
+    qsort(oldstamps, noldstamps, sizeof(*oldstamps), comparestamps);
+    return(YES);
+}
+
+
+/* compare a source file with its stamp in the old cross-reference,
+   and stamp it for the new one.  The file status is trusted unless the
+   file was modified when the old cross-reference was written, and
+   otherwise the contents are compared by their hash */
+static int
+stampfile(unsigned long fileindex, time_t reftime)
+{
+    struct  stat statstruct;	/* file status */
+    FILESTAMP *fs;
+    OLDSTAMP key;
+    OLDSTAMP *old = NULL;
+    unsigned long n;
+
+    /* make sure there is a stamp for every file found so far */
+    if (fileindex >= nfilestamps) {
+	n = nfilestamps;
+	nfilestamps = nsrcfiles;
+	filestamps = myrealloc(filestamps, nfilestamps * sizeof(*filestamps));
+	memset(filestamps + n, 0, (nfilestamps - n) * sizeof(*filestamps));
+    }
+    fs = &filestamps[fileindex];
+    if (fs->state != 0) {
+	return(fs->state);
+    }
+    /* copy the old data of a file that cannot be examined */
+    if (lstat(srcfiles[fileindex], &statstruct) != 0) {
+	fs->hash = NOHASH;
+	fs->hashed = YES;
+	return(fs->state = STAMPMOVED);
+    }
+    fs->size = statstruct.st_size;
+    fs->mtime = statstruct.st_mtime;
+    fs->inode = statstruct.st_ino;
+    if (haveoldstamps == YES) {
+	key.name = srcfiles[fileindex];
+	old = bsearch(&key, oldstamps, noldstamps, sizeof(*oldstamps),
+		      comparestamps);
+    }
+    if (old == NULL) {
+	/* without old stamps, fall back on the modification time */
+	if (haveoldstamps == NO && fs->mtime <= reftime) {
+	    return(fs->state = STAMPMOVED);
+	}
+	return(fs->state = STAMPCHANGED);
+    }
+    if (old->stamp.size != fs->size) {
+	return(fs->state = STAMPCHANGED);
+    }
+    if (old->stamp.mtime == fs->mtime && old->stamp.inode == fs->inode
+	&& fs->mtime < reftime) {
+	fs->hash = old->stamp.hash;
+	fs->hashed = YES;
+	return(fs->state = STAMPSAME);
+    }
+    /* a file that cannot be read now or could not be before has
+       changed */
+    if (hashfile(srcfiles[fileindex], &fs->hash) == NO) {
+	fs->hash = NOHASH;
+	fs->hashed = YES;
+	return(fs->state = STAMPCHANGED);
+    }
+    fs->hashed = YES;
+    if (old->stamp.hash == NOHASH || fs->hash != old->stamp.hash) {
+	return(fs->state = STAMPCHANGED);
+    }
+    return(fs->state = STAMPMOVED);
+}
+
+
+/* form the hash value of a file's contents, which is not NOHASH;
+   returns NO if the file cannot be read */
+static BOOL
+hashfile(char *file, unsigned long long *hash)
+{
+    unsigned char buf[8 * BUFSIZ];
+    unsigned long long h = 14695981039346656037ULL;	/* FNV-1a */
+    ssize_t n;
+    ssize_t i;
+    int     fd;
+
+    if ((fd = myopen(file, O_RDONLY | O_BINARY, 0)) == -1) {
+	return(NO);
+    }
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+	for (i = 0; i < n; ++i) {
+	    h = (h ^ buf[i]) * 1099511628211ULL;
+	}
+    }
+    close(fd);
+    if (n < 0) {
+	return(NO);
+    }
+    *hash = h != NOHASH ? h : h + 1;
+    return(YES);
+}
+
+
+/* make room in the index map for this many files, which are in the
+   delta index until found to be in the inverted index */
+static void
+growindexmap(unsigned long count)
+{
+    static unsigned long size;
+    unsigned long i;
+
+    if (indexmap == NULL) {
+	size = 0;
+    }
+    indexmap = myrealloc(indexmap, count * sizeof(*indexmap));
+    for (i = size; i < count; ++i) {
+	indexmap[i].base = -1;
+	indexmap[i].baseoffset = 0;
+    }
+    size = count;
+}
+
+
+/* put the index map, in file index order, into the cross-reference
+   file.  A newly made inverted index maps every file to itself, and a
+   cross-reference without one has an empty map */
+static void
+putindexmap(void)
+{
+    long    base, baseoffset;
+    int     i;
+
+    fprintf(newrefs, "%d\n", nsrcoffset);
+    for (i = 0; i < nsrcoffset; ++i) {
+	base = i;
+	baseoffset = srcoffset[i];
+	if (deltaindex == YES) {
+	    base = indexmap[i].base;
+	    baseoffset = indexmap[i].baseoffset;
+	}
+	if (fprintf(newrefs, "%ld %ld %ld\n", base, baseoffset,
+		    srcoffset[i]) < 0) {
+	    cannotwrite(newreffile);
+	    /* NOTREACHED */
+	}
+    }
+}
+
+
+/* read the index map that follows the file stamps in a cross-reference
+   trailer */
+static INDEXMAP *
+readindexmap(FILE *refs, long *count)
+{
+    INDEXMAP *map;
+    long    values[3];
+    long    i;
+
+    if (fscanf(refs, "%ld", count) != 1 || *count < 0) {
+	return(NULL);
+    }
+    map = mymalloc((*count + 1) * sizeof(*map));
+    for (i = 0; i < *count; ++i) {
+	if (getnumbers(refs, values, 3) == NO) {
+	    free(map);
+	    return(NULL);
+	}
+	map[i].base = values[0];
+	map[i].baseoffset = values[1];
+	map[i].offset = values[2];
+    }
+    return(map);
+}
+
+
+/* note the segment of the file just output, if it could be read */
+static void
+putsegment(unsigned long fileindex, long start)
+{
+    SEGMENT *seg;
+
+    if (dboffset == start) {
+	return;
+    }
+    if (nnewsegments == mnewsegments) {
+	mnewsegments = mnewsegments == 0 ? 256 : mnewsegments * 2;
+	newsegments = myrealloc(newsegments,
+				mnewsegments * sizeof(*newsegments));
+    }
+    seg = &newsegments[nnewsegments++];
+    seg->fileindex = fileindex;
+    seg->offset = start + 1;	/* after the file marker */
+    seg->symbols = filesymbols;
+    seg->lines = filelines;
+}
+
+
+/* put the file segments, in database order, after the index map in the
+   cross-reference file */
+static void
+putsegments(long end)
+{
+    SEGMENT *seg;
+    long    i;
+
+    fprintf(newrefs, "%ld %ld\n", nnewsegments, end);
+    for (i = 0; i < nnewsegments; ++i) {
+	seg = &newsegments[i];
+	if (fprintf(newrefs, "%lu %ld %lu %lu\n", seg->fileindex,
+		    seg->offset, seg->symbols, seg->lines) < 0) {
+	    cannotwrite(newreffile);
+	    /* NOTREACHED */
+	}
+    }
+    free(newsegments);
+    newsegments = NULL;
+    nnewsegments = mnewsegments = 0;
+}
+
+
+/* read the file segments that follow the index map in a cross-reference
+   trailer, returning NULL for a database written before they were
+   added */
+static SEGMENT *
+getsegments(FILE *refs, long *count, long *end)
+{
+    INDEXMAP *map;
+    SEGMENT *segs;
+    long    values[4];
+    long    nmap;
+    long    i;
+
+    if ((map = readindexmap(refs, &nmap)) == NULL) {
+	return(NULL);
+    }
+    free(map);
+    if (fscanf(refs, "%ld %ld", count, end) != 2 || *count < 0) {
+	return(NULL);
+    }
+    segs = mymalloc((*count + 1) * sizeof(*segs));
+    for (i = 0; i < *count; ++i) {
+	if (getnumbers(refs, values, 4) == NO) {
+	    free(segs);
+	    return(NULL);
+	}
+	segs[i].fileindex = values[0];
+	segs[i].offset = values[1];
+	segs[i].symbols = values[2];
+	segs[i].lines = values[3];
+    }
+    return(segs);
+}
+
+
+/* read a line of count numbers in a cross-reference trailer, after any
+   white space, returning NO if it does not have them.  This is much
+   faster than fscanf() for the many lines of the index map and file
+   segments */
+static BOOL
+getnumbers(FILE *refs, long *values, int count)
+{
+    char    line[128];
+    char    *s, *end;
+    int     i;
+
+    do {
+	if (fgets(line, sizeof(line), refs) == NULL) {
+	    return(NO);
+	}
+	for (s = line; isspace((unsigned char) *s); ++s) {
+	    ;
+	}
+    } while (*s == '\0');
+    for (i = 0; i < count; ++i) {
+	values[i] = strtol(s, &end, 10);
+	if (end == s) {
+	    return(NO);
+	}
+	s = end;
+    }
+    return(YES);
+}
+
+
+/* read the open database's file segments, if it has them and they have
+   not been read yet */
+BOOL
+readsegments(void)
+{
+    FILE    *refs;
+    long    i;
+
+    if (segmentsread == YES) {
+	return(segments != NULL ? YES : NO);
+    }
+    segmentsread = YES;
+    if ((refs = vpfopen(reffile, "rb")) == NULL) {
+	return(NO);
+    }
+    if (fseek(refs, traileroffset, SEEK_SET) != -1
+	&& skiptrailer(refs) == YES) {
+	segments = getsegments(refs, &nsegments, &segmentsend);
+    }
+    fclose(refs);
+
+    /* ignore segments of files not in the file list */
+    for (i = 0; segments != NULL && i < nsegments; ++i) {
+	if (segments[i].fileindex >= nsrcfiles) {
+	    free(segments);
+	    segments = NULL;
+	    nsegments = 0;
+	}
+    }
+    return(segments != NULL ? YES : NO);
+}
+
+/* skip the directory and file lists and the file stamps in a
+   cross-reference trailer */
+static BOOL
+skiptrailer(FILE *refs)
+{
+    unsigned long count;
+    int     list;
+
+    for (list = 0; list < 4; ++list) {
+	if (fscanf(refs, "%lu", &count) != 1) {
+	    return(NO);
+	}
+	/* skip the string space size */
+	if (list == 2 && fscanf(refs, "%*s") != 0) {
+	    return(NO);
+	}
+	if (skiplines(refs, count) == NO) {
+	    return(NO);
+	}
+    }
+    return(YES);
+}
+
+
+/* skip count lines of a cross-reference trailer list, and the blank
+   lines before them */
+static BOOL
+skiplines(FILE *refs, unsigned long count)
+{
+    char    line[PATHLEN + 2];
+    BOOL    blank = YES;	/* the line so far is white space */
+    char    *s;
+
+    while (count > 0 && fgets(line, sizeof(line), refs) != NULL) {
+	for (s = line; blank == YES && *s != '\0'; ++s) {
+	    if (!isspace((unsigned char) *s)) {
+		blank = NO;
+	    }
+	}
+	s = line + strlen(line);
+	if (s > line && s[-1] == '\n') {
+	    if (blank == NO) {
+		--count;
+	    }
+	    blank = YES;
+	}
+    }
+    return(count == 0 ? YES : NO);
+}
+
+
+/* free the source file stamps */
+static void
+freestamps(void)
+{
+    unsigned long i;
+
+    for (i = 0; i < noldstamps; ++i) {
+	free(oldstamps[i].name);
+    }
+    free(oldstamps);
+    oldstamps = NULL;
+    noldstamps = 0;
+    haveoldstamps = NO;
+    free(filestamps);
+    filestamps = NULL;
+    nfilestamps = 0;
+}
+
+
 /* copy this file's symbol data */
 static void
 copydata(void)
 {
     char *cp;
+    char *tp;
 
     setmark('\t');
     cp = blockp;
     for (;;) {
 	/* copy up to the next \t */
 	do {	/* innermost loop optimized to only one test */
-	    while (*cp != '\t') {
-		dbputc(*cp++);
-	    }
+	    tp = findmark(cp);
+	    dbfwrite(cp, tp - cp);
+	    cp = tp;
 	} while (*++cp == '\0' && (cp = read_block()) != NULL);
 	dbputc('\t');	/* copy the tab */
 		
@@ -643,6 +1844,7 @@ static void
 copyinverted(void)
 {
     char    *cp;
+    char    *np;
     char    c;
     int     type;   /* reference type (mark character) */
     char    symbol[PATLEN + 1];
@@ -654,9 +1856,9 @@ copyinverted(void)
     for (;;) {
 	setmark('\n');
 	do {	/* innermost loop optimized to only one test */
-	    while (*cp != '\n') {
-		dbputc(*cp++);
-	    }
+	    np = findmark(cp);
+	    dbfwrite(cp, np - cp);
+	    cp = np;
 	} while (*++cp == '\0' && (cp = read_block()) != NULL);
 	dbputc('\n');	/* copy the newline */
 		
@@ -44,12 +44,37 @@
 /* database output macros that update its offset */
 #define	dbputc(c)	(++dboffset, (void) putc(c, newrefs))
 #define	dbfputs(s)	(dboffset += strlen(s), fputs(s, newrefs))
+#define	dbfwrite(s, n)	(dboffset += (n), (void) fwrite(s, 1, n, newrefs))
+
+/* a source file's cross-reference written by a parallel build job */
+typedef	struct {
+	unsigned long fileindex;	/* source file name index */
+	long	size;		/* cross-reference size in bytes */
+	long	postsize;	/* postings size in bytes */
+	long	npostings;	/* number of postings */
+	long	nameoffset;	/* file name offset in the cross-reference */
+	BOOL	errors;		/* errors found */
+	double	seconds;	/* time to cross-reference it */
+	unsigned long symbols;	/* symbols in it */
+	unsigned long lines;	/* its lines with symbols */
+} FRAGMENT;
+
+/* a source file's segment of the cross-reference, listed in the trailer */
+typedef	struct {
+	unsigned long fileindex;	/* source file name index */
+	long	offset;		/* database offset of the file name */
+	unsigned long symbols;	/* symbols in it */
+	unsigned long lines;	/* its lines with symbols */
+} SEGMENT;
 
 /* declarations for globals defined in build.c */
 
 extern	BOOL	buildonly;	/* only build the database */
 extern	BOOL	unconditional;	/* unconditionally build database */
 extern	BOOL	fileschanged;	/* assume some files changed */
+extern	long	memorylimit;	/* build memory budget in bytes, or 0 */
+extern	unsigned long *passstart; /* first file of each pass of the last build */
+extern	int	npasses;	/* number of them, or 0 if it was up-to-date */
 
 extern	char	*reffile;	/* cross-reference file path name */
 extern	char	*invname; 	/* inverted index to the database */
@@ -61,13 +86,26 @@ extern	int	symrefs;	/* cross-reference file */
 
 extern	INVCONTROL invcontrol;	/* inverted file control structure */
 
+extern	SEGMENT	*segments;	/* the database's file segments, or NULL */
+extern	long	nsegments;	/* number of them */
+extern	long	segmentsend;	/* database offset of the empty last name */
+extern	unsigned long filesymbols; /* symbols in the file being output */
+extern	unsigned long filelines; /* its lines with symbols */
+
 /* Prototypes of external functions defined by build.c */
 
 void	build(void);
 void	free_newbuildfiles(void);
 void	opendatabase(void);
+BOOL	opentermindex(INVCONTROL *invcntl);
+BOOL	readsegments(void);
 void	rebuild(void);
 void	setup_build_filenames(char *reffile);
 void 	seek_to_trailer(FILE *f);
 
+/* Prototypes of external functions defined by crossref.c */
+
+void	putfragment(FRAGMENT *frag, FILE *data, FILE *posts,
+		    unsigned int *termmap);
+
 #endif /* CSCOPE_BUILD_H */
@@ -0,0 +1,246 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+/*	cscope - interactive C symbol cross-reference
+ *
+ *	build statistics
+ *
+ *	The --build-stats option times each phase of a build and reports
+ *	it, with the slowest and largest files cross-referenced and the
+ *	inverted index totals, one record per line of space separated
+ *	names and values so the reports can be collected and compared.
+ */
+
+#include "global.h"
+#include "alloc.h"
+#include "build.h"
+#include "buildstats.h"
+#include "invlib.h"
+#include "jobs.h"
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+
+BOOL	buildstats = NO;	/* report build statistics */
+char	*buildstatsfile;	/* file to append them to, or NULL */
+
+typedef	struct {
+	double	wall;		/* wall clock seconds */
+	double	cpu;		/* CPU seconds */
+	long	bytes;		/* bytes read or written */
+	long	items;		/* files, postings, or terms */
+} PHASE;
+
+typedef	struct {
+	char	*name;		/* file name */
+	double	seconds;	/* time to cross-reference it */
+	long	bytes;		/* its size */
+} STATFILE;
+
+static	char	*phasename[NSTATPHASES] = {
+	"filelist", "crossref", "copy", "sort", "invmake"
+};
+static	PHASE	phases[NSTATPHASES];
+static	STATFILE slowest[STATFILES];	/* slowest files, slowest first */
+static	STATFILE largest[STATFILES];	/* largest files, largest first */
+static	int	nslowest, nlargest;
+static	STATTIME begin;		/* time of the first statistic */
+static	BOOL	begun;
+
+static	void	addfile(STATFILE *list, int *count, STATFILE *f, BOOL bysize);
+
+
+/* get the wall clock and CPU time */
+void
+stattime(STATTIME *t)
+{
+    struct timeval tv;
+    struct rusage self, children;
+
+    if (buildstats == NO) {
+	return;
+    }
+    gettimeofday(&tv, NULL);
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    t->wall = tv.tv_sec + tv.tv_usec / 1e6;
+    t->cpu = self.ru_utime.tv_sec + self.ru_utime.tv_usec / 1e6
+	+ self.ru_stime.tv_sec + self.ru_stime.tv_usec / 1e6
+	+ children.ru_utime.tv_sec + children.ru_utime.tv_usec / 1e6
+	+ children.ru_stime.tv_sec + children.ru_stime.tv_usec / 1e6;
+    if (begun == NO) {
+	begin = *t;
+	begun = YES;
+    }
+}
+
+
+/* add the time since start, and the bytes and items done, to a phase,
+   returning the wall clock time */
+double
+statphase(int phase, STATTIME *start, long bytes, long items)
+{
+    STATTIME now;
+
+    if (buildstats == NO) {
+	return(0);
+    }
+    stattime(&now);
+    phases[phase].wall += now.wall - start->wall;
+    phases[phase].cpu += now.cpu - start->cpu;
+    phases[phase].bytes += bytes;
+    phases[phase].items += items;
+    return(now.wall - start->wall);
+}
+
+
+/* note the time to cross-reference a file, and its size */
+void
+statfile(char *file, double seconds)
+{
+    struct stat statstruct;
+    STATFILE f;
+
+    if (buildstats == NO) {
+	return;
+    }
+    f.name = file;
+    f.seconds = seconds;
+    f.bytes = 0;
+    if (stat(filepath(file), &statstruct) == 0) {
+	f.bytes = statstruct.st_size;
+    }
+    phases[STATCROSSREF].bytes += f.bytes;
+    addfile(slowest, &nslowest, &f, NO);
+    addfile(largest, &nlargest, &f, YES);
+}
+
+
+/* add a file to a list if it is among the slowest or largest */
+static void
+addfile(STATFILE *list, int *count, STATFILE *f, BOOL bysize)
+{
+    int     i;
+
+    for (i = *count; i > 0; --i) {
+	if (bysize == YES ? list[i - 1].bytes >= f->bytes
+	    : list[i - 1].seconds >= f->seconds) {
+	    break;
+	}
+    }
+    if (i == STATFILES) {
+	return;
+    }
+    if (*count == STATFILES) {
+	free(list[--*count].name);
+    }
+    memmove(list + i + 1, list + i, (*count - i) * sizeof(*list));
+    list[i] = *f;
+    list[i].name = my_strdup(f->name);
+    ++*count;
+}
+
+
+/* get the peak resident set sizes, in kilobytes, of cscope and of the
+   largest of its finished build jobs */
+void
+peakmemory(long *self, long *children)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    *self = usage.ru_maxrss;
+    getrusage(RUSAGE_CHILDREN, &usage);
+    *children = usage.ru_maxrss;
+}
+
+
+/* report the build statistics, and start over */
+void
+putbuildstats(void)
+{
+    FILE    *f = stderr;
+    STATTIME now;
+    PHASE   *p;
+    long    self, children;
+    int     i;
+
+    if (buildstats == NO) {
+	return;
+    }
+    if (buildstatsfile != NULL
+	&& (f = myfopen(buildstatsfile, "a")) == NULL) {
+	posterr("cscope: cannot open build statistics file %s\n",
+		buildstatsfile);
+	f = stderr;
+    }
+    stattime(&now);
+    fprintf(f, "build time %ld files %lu jobs %d wall %.3f cpu %.3f\n",
+	    (long) time(NULL), nsrcfiles, njobs, now.wall - begin.wall,
+	    now.cpu - begin.cpu);
+    for (i = 0; i < NSTATPHASES; ++i) {
+	p = &phases[i];
+	fprintf(f, "phase %s wall %.3f cpu %.3f bytes %ld items %ld\n",
+		phasename[i], p->wall, p->cpu, p->bytes, p->items);
+    }
+    peakmemory(&self, &children);
+    fprintf(f, "memory limit %ld peak %ld jobs %ld\n", memorylimit / 1024,
+	    self, children);
+    if (phases[STATINVMAKE].items > 0) {
+	fprintf(f, "index postings %ld terms %ld blocks %ld bytes %ld\n",
+		invpostings, invterms, invblocks, invbytes);
+    }
+    for (i = 0; i < nslowest; ++i) {
+	fprintf(f, "slowest %d seconds %.6f bytes %ld file %s\n", i + 1,
+		slowest[i].seconds, slowest[i].bytes, slowest[i].name);
+    }
+    for (i = 0; i < nlargest; ++i) {
+	fprintf(f, "largest %d bytes %ld seconds %.6f file %s\n", i + 1,
+		largest[i].bytes, largest[i].seconds, largest[i].name);
+    }
+    fprintf(f, "end\n");
+    if (f != stderr) {
+	fclose(f);
+    }
+    /* start over for an interactive rebuild */
+    for (i = 0; i < nslowest; ++i) {
+	free(slowest[i].name);
+    }
+    for (i = 0; i < nlargest; ++i) {
+	free(largest[i].name);
+    }
+    nslowest = nlargest = 0;
+    memset(phases, 0, sizeof(phases));
+    begun = NO;
+}
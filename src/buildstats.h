@@ -0,0 +1,63 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+#ifndef CSCOPE_BUILDSTATS_H
+#define CSCOPE_BUILDSTATS_H
+
+#include "global.h"
+
+/* build statistics */
+
+#define	STATFILELIST	0	/* finding the source files */
+#define	STATCROSSREF	1	/* cross-referencing new and changed files */
+#define	STATCOPY	2	/* copying old cross-reference data */
+#define	STATSORT	3	/* sorting the inverted index postings */
+#define	STATINVMAKE	4	/* making the inverted index */
+#define	NSTATPHASES	5
+
+#define	STATFILES	10	/* slowest and largest files listed */
+
+typedef	struct {
+	double	wall;		/* wall clock seconds */
+	double	cpu;		/* CPU seconds, with finished children's */
+} STATTIME;
+
+extern	BOOL	buildstats;	/* report build statistics */
+extern	char	*buildstatsfile; /* file to append them to, or NULL */
+
+void	peakmemory(long *self, long *children);
+void	putbuildstats(void);
+void	statfile(char *file, double seconds);
+double	statphase(int phase, STATTIME *start, long bytes, long items);
+void	stattime(STATTIME *t);
+
+#endif /* CSCOPE_BUILDSTATS_H */
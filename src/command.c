@@ -38,6 +38,7 @@
 #include "global.h"
 #include "build.h"		/* for rebuild() */
 #include "alloc.h"
+#include "buildstats.h"
 
 #include <stdlib.h>
 #if defined(USE_NCURSES) && !defined(RENAMED_NCURSES)
@@ -85,6 +86,7 @@ command(int commandc)
     FILE *file;
     struct cmd *curritem, *item;	/* command history */
     char *s;
+    STATTIME statstart;		/* start of finding the source files */
 
     switch (commandc) {
     case ctrl('C'):	/* toggle caseless mode */
@@ -105,7 +107,9 @@ command(int commandc)
 	}
 	exitcurses();
 	freefilelist();		/* remake the source file list */
+	stattime(&statstart);
 	makefilelist();
+	statphase(STATFILELIST, &statstart, 0, nsrcfiles);
 	rebuild();
 	if (errorsfound == YES) {
 	    errorsfound = NO;
@@ -51,6 +51,12 @@
 /* set the mark character for searching the cross-reference file */
 #define	setmark(c)	(blockmark = c, block[blocklen] = blockmark)
 
+/* find the mark character at or after cp in the block; memchr() compares
+   a word or vector of characters at a time, and always finds the mark
+   at the end of the block */
+#define	findmark(cp)	((char *) memchr(cp, blockmark, \
+				block + blocklen + 1 - (cp)))
+
 /* get the next character in the cross-reference */
 /* note that blockp is assumed not to be null */
 #define	getrefchar()	(*(++blockp + 1) != '\0' ? *blockp : \
@@ -73,6 +79,7 @@
 #define	NAMEFILE "cscope.files"	/* default list-of-files file */
 #define	INVNAME	"cscope.in.out"	/* inverted index to the database */
 #define	INVPOST	"cscope.po.out"	/* inverted index postings */
+#define	TRIGRAMS "cscope.tg.out"	/* trigram index of the source files */
 #define	INVNAME2 "cscope.out.in"/* follows correct naming convention */
 #define	INVPOST2 "cscope.out.po"/* follows correct naming convention */
 
@@ -102,6 +109,7 @@
 #define FILENAME	7
 #define INCLUDES	8
 #define	FIELDS		10
+#define	OUTLINE		11	/* line mode only: definitions in files */
 
 #if (BSD || V9) && !__NetBSD__ && !__FreeBSD__ && !__APPLE__
 # define TERMINFO	0	/* no terminfo curses */
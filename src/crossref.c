@@ -41,29 +41,15 @@
 #include "build.h"
 #include "scanner.h"
 #include "alloc.h"
+#include "postsort.h"
 
+#include <limits.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 
 static char const rcsid[] = "$Id: crossref.c,v 1.16 2014/11/20 21:12:54 broeker Exp $";
 
 
-/* convert long to a string in base BASE notation */
-#define	ltobase(value)                     \
-do {                                       \
-	n = (value);                       \
-	s = buf + (sizeof(buf) - 1);       \
-	*s = '\0';                         \
-	digits = 1;                        \
-	while (n >= BASE) {                \
-		++digits;                  \
-		i = n;                     \
-		n /= BASE;                 \
-		*--s = i - n * BASE + '!'; \
-	}                                  \
-	*--s = n + '!';                    \
-} while (0)
-
 #define	SYMBOLINC	20	/* symbol list size increment */
 
 long	dboffset;		/* new database offset */
@@ -73,6 +59,8 @@ long	npostings;		/* number of postings */
 int	nsrcoffset;             /* number of file name database offsets */
 long	*srcoffset;             /* source file name database offsets */
 unsigned long symbols;		/* number of symbols */
+unsigned long filesymbols;	/* symbols in the file being output */
+unsigned long filelines;	/* its lines with symbols */
 
 static	char	*filename;	/* file name for warning messages */
 static	long	fcnoffset;	/* function name database offset */
@@ -88,13 +76,31 @@ struct	symbol {	/* symbol data */
 };
 static struct symbol *symbol;
 
+/* the symbols already on the line are found by hashing, so a long
+   generated line does not take quadratic time */
+#define	SYMHASHINIT	64	/* initial symbol hash table size, a power of 2 */
+
+struct	symslot {	/* symbol hash table slot */
+    unsigned long line;		/* line the slot was filled on */
+    unsigned long index;	/* symbol list index */
+};
+static struct symslot *symhash;
+static unsigned long symhashsize;	/* hash table size */
+static unsigned long symline;	/* current line, for emptying the table */
+
+static	void	checkpostfiles(void);
+static	struct symslot *samesymbol(int token, unsigned int num,
+				       unsigned int length);
 static	void	putcrossref(void);
+static	void	rehashsymbols(void);
 static	void	savesymbol(int token, int num);
+static	unsigned long symbolhash(int token, unsigned int num,
+				 unsigned int first, unsigned int length);
 
 void
 crossref(char *srcfile)
 {
-    unsigned int i;
+    struct symslot *slot;	/* symbol hash table slot */
     unsigned int length;	/* symbol length */
     unsigned int entry_no;	/* function level of the symbol */
     int token;                  /* current token */
@@ -148,19 +154,14 @@ crossref(char *srcfile)
 		entry_no++;
 	    }
 	    /* see if the symbol is already in the list */
-	    for (i = 0; i < symbols; ++i) {
-		if (length == symbol[i].length
-		    && strncmp(my_yytext + first,
-			       my_yytext + symbol[i].first,
-			       length) == 0 
-		    && entry_no == symbol[i].fcn_level
-		    && token == symbol[i].type
-		    ) {	/* could be a::a() */
-		    break;
-		}
-	    }
-	    if (i == symbols) {	/* if not already in list */
+	    slot = samesymbol(token, entry_no, length);
+	    if (symbols == 0 || slot->line != symline) {	/* if not already in list */
 		savesymbol(token, entry_no);
+		slot->line = symline;
+		slot->index = symbols - 1;
+		if (symbols * 2 > symhashsize) {
+		    rehashsymbols();
+		}
 	    }
 	    break;
 
@@ -200,6 +201,10 @@ crossref(char *srcfile)
 static void
 savesymbol(int token, int num)
 {
+    /* a new line empties the hash table */
+    if (symbols == 0) {
+	++symline;
+    }
     /* make sure there is room for the symbol */
     if (symbols == msymbols) {
 	msymbols += SYMBOLINC;
@@ -214,6 +219,85 @@ savesymbol(int token, int num)
     ++symbols;
 }
 
+/* find the symbol's slot in the hash table, which is filled on this line
+   if the symbol is already in the list */
+
+static struct symslot *
+samesymbol(int token, unsigned int num, unsigned int length)
+{
+    struct symslot *slot;
+    struct symbol *sp;
+    unsigned long h;
+
+    if (symhash == NULL) {
+	symhashsize = SYMHASHINIT;
+	symhash = mymalloc(symhashsize * sizeof(*symhash));
+	memset(symhash, 0, symhashsize * sizeof(*symhash));
+	symline = 1;
+    }
+    /* the table is emptied when the line's first symbol is saved */
+    h = symbolhash(token, num, first, length);
+    if (symbols == 0) {
+	return(&symhash[h & (symhashsize - 1)]);
+    }
+    for ( ; ; ++h) {
+	slot = &symhash[h & (symhashsize - 1)];
+	if (slot->line != symline) {
+	    return(slot);
+	}
+	sp = &symbol[slot->index];
+	if (length == sp->length
+	    && strncmp(my_yytext + first, my_yytext + sp->first, length) == 0
+	    && num == sp->fcn_level
+	    && token == sp->type) {	/* could be a::a() */
+	    return(slot);
+	}
+    }
+}
+
+/* double the symbol hash table and put the line's symbols back in it */
+
+static void
+rehashsymbols(void)
+{
+    struct symslot *slot;
+    struct symbol *sp;
+    unsigned long h;
+    unsigned long i;
+
+    free(symhash);
+    symhashsize *= 2;
+    symhash = mymalloc(symhashsize * sizeof(*symhash));
+    memset(symhash, 0, symhashsize * sizeof(*symhash));
+    for (i = 0; i < symbols; ++i) {
+	sp = &symbol[i];
+	if (sp->length == 0) {	/* not in the table */
+	    continue;
+	}
+	h = symbolhash(sp->type, sp->fcn_level, sp->first, sp->length);
+	while ((slot = &symhash[h & (symhashsize - 1)])->line == symline) {
+	    ++h;
+	}
+	slot->line = symline;
+	slot->index = i;
+    }
+}
+
+/* form the hash value of a symbol */
+
+static unsigned long
+symbolhash(int token, unsigned int num, unsigned int first,
+	   unsigned int length)
+{
+    unsigned char *s = (unsigned char *) my_yytext + first;
+    unsigned long h = token * 31 + num;
+
+    while (length-- > 0) {
+	h = h * 31 + *s++;
+    }
+    return(h ^ (h >> 16));
+}
+
 /* output the file name */
 
 void
@@ -228,9 +312,11 @@ putfilename(char *srcfile)
 	++dboffset;
 	if (invertedindex == YES) {
 		srcoffset[nsrcoffset++] = dboffset;
+		checkpostfiles();
 	}
 	dbfputs(srcfile);
 	fcnoffset = macrooffset = 0;
+	filesymbols = filelines = 0;
 }
 
 /* output the symbols and source line */
@@ -371,6 +457,8 @@ putcrossref(void)
 	dbputc('\n');	/* mark beginning of next source line */
 	macrooffset = 0;
     }
+    filesymbols += symput;
+    ++filelines;
     symbols = 0;
 }
 
@@ -385,16 +473,24 @@ freecrossref()
 	symbols = 0;
 }
 
+/* check that the postings' file index can number the files */
+
+static void
+checkpostfiles(void)
+{
+	if (nsrcoffset > MAXPOSTFILES) {
+		postfatal("cscope: too many files for the inverted index\n");
+		/* NOTREACHED */
+	}
+}
+
 /* output the inverted index posting */
 
 void
 putposting(char *term, int type)
 {
-	long	i, n;
-	char	*s;
-	int	digits;		/* digits output */
+	TEMPPOSTING p;
 	long	offset;		/* function/macro database offset */
-	char	buf[11];		/* number buffer */
 
 	/* get the function or macro name offset */
 	offset = fcnoffset;
@@ -424,40 +520,79 @@ putposting(char *term, int type)
 	if (type == INCLUDE) {
 		++term;
 	}
-	/* output the posting, which should be as small as possible to reduce
-	   the temp file size and sort time */
-	(void) fputs(term, postings);
-	(void) putc(' ', postings);
-
-	/* the line offset is padded so postings for the same term will sort
-	   in ascending line offset order to order the references as they
-	   appear withing a source file */
-	ltobase(lineoffset);
-	for (i = PRECISION - digits; i > 0; --i) {
-		(void) putc('!', postings);
+	/* output the posting with its offsets from the file name, so build
+	   jobs' postings don't need relocating */
+	p.term = postterm(term);
+	p.fileindex = nsrcoffset - 1;
+	p.type = type;
+	/* the function name is before the line, so its offset fits too */
+	if (lineoffset - srcoffset[nsrcoffset - 1] > UINT_MAX) {
+		postfatal("cscope: %s is too large for the inverted index\n",
+			  filename);
+		/* NOTREACHED */
 	}
-	do {
-		(void) putc(*s, postings);
-	} while (*++s != '\0');
-	
-	/* postings are also sorted by type */
-	(void) putc(type, postings);
-	
-	/* function or macro name offset */
+	p.lineoffset = lineoffset - srcoffset[nsrcoffset - 1];
+	p.fcnoffset = 0;
 	if (offset > 0) {
-		(void) putc(' ', postings);
-		ltobase(offset);
-		do {
-			(void) putc(*s, postings);
-		} while (*++s != '\0');
+		p.fcnoffset = offset - srcoffset[nsrcoffset - 1];
 	}
-	if (putc('\n', postings) == EOF) {
+	if (fwrite(&p, sizeof(p), 1, postings) != 1) {
 		cannotwrite(temp1);
 		/* NOTREACHED */
 	}
 	++npostings;
 }
 
+/* copy a file's cross-reference and postings written by a build job,
+   converting the job's term numbers with the term map */
+
+void
+putfragment(FRAGMENT *frag, FILE *data, FILE *posts, unsigned int *termmap)
+{
+	char	buf[BUFSIZ];
+	TEMPPOSTING p;
+	long	left;
+	long	i;
+	size_t	n;
+
+	if (frag->nameoffset >= 0 && invertedindex == YES) {
+		srcoffset[nsrcoffset++] = dboffset + frag->nameoffset;
+		checkpostfiles();
+	}
+	/* copy the cross-reference */
+	for (left = frag->size; left > 0; left -= n) {
+		n = left < (long) sizeof(buf) ? (size_t) left : sizeof(buf);
+		if (fread(buf, 1, n, data) != n) {
+			postfatal("cscope: cannot read build job data\n");
+			/* NOTREACHED */
+		}
+		if (fwrite(buf, 1, n, newrefs) != n) {
+			cannotwrite(newreffile);
+			/* NOTREACHED */
+		}
+	}
+	dboffset += frag->size;
+	filesymbols = frag->symbols;
+	filelines = frag->lines;
+	if (invertedindex == NO) {
+		return;
+	}
+	/* copy the postings */
+	for (i = 0; i < frag->npostings; ++i) {
+		if (fread(&p, sizeof(p), 1, posts) != 1) {
+			postfatal("cscope: cannot read build job postings\n");
+			/* NOTREACHED */
+		}
+		p.term = termmap[p.term];
+		p.fileindex = nsrcoffset - 1;
+		if (fwrite(&p, sizeof(p), 1, postings) != 1) {
+			cannotwrite(temp1);
+			/* NOTREACHED */
+		}
+		++npostings;
+	}
+}
+
 /* put the string into the new database */
 
 void
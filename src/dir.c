@@ -38,21 +38,30 @@
 
 #include "global.h"
 #include "alloc.h"
+#include "blocks.h"
+#include "jobs.h"
 #include "vp.h"		/* vpdirs and vpndirs */
 
 #include <stdlib.h>
 #include <sys/types.h>	/* needed by stat.h and dirent.h */
 #include <dirent.h>
+#include <fcntl.h>	/* openat */
 #include <sys/stat.h>	/* stat */
+#include <unistd.h>	/* faccessat */
 #include <assert.h>
 
+#ifndef O_DIRECTORY
+#define	O_DIRECTORY	0
+#endif
+
 static char const rcsid[] = "$Id: dir.c,v 1.33 2014/11/20 21:12:54 broeker Exp $";
 
 #define	DIRSEPS	" ,:"	/* directory list separators */
 #define	DIRINC	10	/* directory list size increment */
-#define HASHMOD	2003	/* must be a prime number */
-#define	SRCINC	HASHMOD	/* source file list size increment */
+#define	SRCINC	2003	/* source file list size increment */
 			/* largest known database had 22049 files */
+#define	SRCHASHINIT	4096	/* initial file name hash table size, a power of 2 */
+#define	WALKTASKS	8	/* directory walk tasks per build job */
 
 char	currentdir[PATHLEN + 1];/* current directory */
 char	**incdirs;		/* #include directories */
@@ -68,10 +77,12 @@ static	unsigned long mincdirs = DIRINC; /* maximum number of #include directorie
 static	unsigned long msrcdirs; /* maximum number of source directories */
 static	unsigned long nvpsrcdirs; /* number of view path source directories */
 
-static	struct	listitem {	/* source file names without view pathing */
-	char	*text;
-	struct	listitem *next;
-} *srcnames[HASHMOD];
+static	NAMETABLE srcnames;	/* source file names, pointing into srcfiles */
+static	NAMETABLE includes;	/* #include type and name pairs resolved */
+
+static	char	**walkdirs;	/* directories to walk in parallel */
+static	int	nwalkdirs;	/* number of them */
+static	int	mwalkdirs;	/* maximum number of them */
 
 /* Internal prototypes: */
 static	BOOL	accessible_file(char *file);
@@ -79,7 +90,13 @@ static	BOOL	issrcfile(char *file);
 static	void	addsrcdir(char *dir);
 static	void	addincdir(char *name, char *path);
 static	void	scan_dir(const char *dirfile, BOOL recurse);
+static	void	foundsrcfile(char *path, FILE *found);
 static	void	makevpsrcdirs(void);
+static	unsigned long pathhash(char *path);
+static	void	rehashnames(NAMETABLE *table);
+static	void	walkdir(int parentfd, char *name, char *path, size_t len,
+			BOOL recurse, BOOL listdirs, FILE *found);
+static	BOOL	walktask(int task, void *arg);
 
 
 /* make the view source directory list */
@@ -359,6 +376,9 @@ cscope: Syntax error in namelist file %s: unfinished -I or -p option\n",
 		case 'T':	/* truncate symbols to 8 characters */
 		    trun_syms = YES;
 		    break;
+		case 'z':	/* block-compress the crossref */
+		    blockcompress = YES;
+		    break;
 		case 'I':	/* #include file directory */
 		case 'p':	/* file path components to display */
 		    s = path + 2;		/* for "-Ipath" */
@@ -475,52 +495,176 @@ cscope: Syntax error in namelist file %s: unfinished -I or -p option\n",
 
 }
 
-/* scan a directory (recursively?) for source files */
+/* scan a directory (recursively?) for source files.  With parallel
+   build jobs, the parent walks the top of the tree until there are
+   enough subdirectories to share out, and the jobs walk those */
 static void
 scan_dir(const char *adir, BOOL recurse_dir)
+{
+	char	path[PATHLEN + 1];
+	char	line[PATHLEN + 2];
+	FILE	*found;
+	int	first;
+	int	task;
+	size_t	len;
+
+	if ((len = strlen(adir)) > PATHLEN) {
+		return;
+	}
+	strcpy(path, adir);
+	if (recurse_dir == NO || njobs <= 1) {
+		walkdir(AT_FDCWD, path, path, len, recurse_dir, NO, NULL);
+		return;
+	}
+	nwalkdirs = 0;
+	walkdir(AT_FDCWD, path, path, len, YES, YES, NULL);
+	for (first = 0; first < nwalkdirs
+		     && nwalkdirs - first < njobs * WALKTASKS; ++first) {
+		strcpy(path, walkdirs[first]);
+		walkdir(AT_FDCWD, path, path, strlen(path), YES, YES, NULL);
+	}
+	/* the parent adds the files the jobs found, in task order */
+	if (nwalkdirs > first) {
+		if (runjobs(nwalkdirs - first, walktask, &first) == YES) {
+			for (task = 0; task < nwalkdirs - first; ++task) {
+				if ((found = myfopen(jobfile(task, ".f"),
+						     "r")) == NULL) {
+					continue;
+				}
+				while (fgets(line, sizeof(line), found) != NULL) {
+					line[strcspn(line, "\n")] = '\0';
+					foundsrcfile(line, NULL);
+				}
+				fclose(found);
+			}
+			first = nwalkdirs;
+		}
+		removejobfiles();
+	}
+	/* walk any the jobs could not */
+	for (; first < nwalkdirs; ++first) {
+		strcpy(path, walkdirs[first]);
+		walkdir(AT_FDCWD, path, path, strlen(path), YES, NO, NULL);
+	}
+	while (nwalkdirs > 0) {
+		free(walkdirs[--nwalkdirs]);
+	}
+}
+
+
+/* build job task: walk a directory tree, writing the source files
+   found to the task's file */
+static BOOL
+walktask(int task, void *arg)
+{
+	char	path[PATHLEN + 1];
+	FILE	*found;
+
+	if ((found = myfopen(jobfile(task, ".f"), "w")) == NULL) {
+		return(NO);
+	}
+	strcpy(path, walkdirs[task + *(int *) arg]);
+	walkdir(AT_FDCWD, path, path, strlen(path), YES, NO, found);
+	return(fclose(found) != EOF);
+}
+
+
+/* walk a directory, opened relative to the directory parentfd, whose
+   path is path[0..len).  Directory entry types are used where the
+   system has them so only a source file candidate costs a system
+   call, and subdirectories are listed for later instead of walked if
+   listdirs is set */
+static void
+walkdir(int parentfd, char *name, char *path, size_t len, BOOL recurse,
+	BOOL listdirs, FILE *found)
 {
 	DIR	*dirfile;
-	int adir_len = strlen(adir);
-
-	/* FIXME: no guards against adir_len > PATHLEN, yet */
-
-	if ((dirfile = opendir(adir)) != NULL) {
-		struct dirent *entry;
-		char	path[PATHLEN + 1];
-
-		while ((entry = readdir(dirfile)) != NULL) { 
-			if ((strcmp(".",entry->d_name) != 0)
-			    && (strcmp("..",entry->d_name) != 0)) {
-				struct stat buf;
-
-				snprintf(path, sizeof(path), "%s/%.*s", adir,
-					PATHLEN - 2 - adir_len,
-					entry->d_name);
-
-				if (lstat(path,&buf) == 0) {
-					if (recurse_dir 
-                                            && S_ISDIR(buf.st_mode) ) {
-						scan_dir(path, recurse_dir);
-					} else if (issrcfile(path)
-						   && infilelist(path) == NO
-						   && access(path, R_OK) == 0) {
-						addsrcfile(path);
-					}
+	struct	dirent *entry;
+	struct	stat buf;
+	BOOL	isdir, isreg;
+	size_t	namelen;
+	int	fd;
+
+	if ((fd = openat(parentfd, name, O_RDONLY | O_DIRECTORY)) == -1) {
+		return;
+	}
+	if ((dirfile = fdopendir(fd)) == NULL) {
+		close(fd);
+		return;
+	}
+	while ((entry = readdir(dirfile)) != NULL) {
+		if (strcmp(".", entry->d_name) == 0
+		    || strcmp("..", entry->d_name) == 0) {
+			continue;
+		}
+		namelen = strlen(entry->d_name);
+		if (len + namelen + 1 > PATHLEN) {
+			continue;
+		}
+		isdir = isreg = NO;
+#ifdef DT_UNKNOWN
+		if (entry->d_type != DT_UNKNOWN) {
+			isdir = entry->d_type == DT_DIR;
+			isreg = entry->d_type == DT_REG;
+		} else
+#endif
+		if ((recurse == YES || issrcfile(entry->d_name) == YES)
+		    && fstatat(fd, entry->d_name, &buf,
+			       AT_SYMLINK_NOFOLLOW) == 0) {
+			isdir = S_ISDIR(buf.st_mode);
+			isreg = S_ISREG(buf.st_mode);
+		}
+		path[len] = '/';
+		strcpy(path + len + 1, entry->d_name);
+		if (isdir) {
+			if (recurse == NO) {
+				continue;
+			}
+			if (listdirs == YES) {
+				if (nwalkdirs == mwalkdirs) {
+					mwalkdirs += DIRINC;
+					walkdirs = myrealloc(walkdirs, mwalkdirs
+							     * sizeof(*walkdirs));
 				}
+				walkdirs[nwalkdirs++] = my_strdup(path);
+			} else {
+				walkdir(fd, entry->d_name, path,
+					len + 1 + namelen, YES, NO, found);
 			}
+		} else if (isreg && issrcfile(entry->d_name) == YES
+			   && faccessat(fd, entry->d_name, R_OK, 0) == 0) {
+			foundsrcfile(path, found);
 		}
-		closedir(dirfile);
 	}
-        return;
+	path[len] = '\0';
+	closedir(dirfile);
+}
+
+
+/* add a source file found by a directory walk to the list, or write
+   it to a build job's file */
+static void
+foundsrcfile(char *path, FILE *found)
+{
+	char	file[PATHLEN + 1];
+
+	if (found != NULL) {
+		fprintf(found, "%s\n", path);
+		return;
+	}
+	/* leave the walk's path alone, since compath() changes its
+	   argument */
+	strcpy(file, path);
+	if (infilelist(file) == NO) {
+		addsrcfile(file);
+	}
 }
 
 
-/* see if this is a source file */
+/* see if this file name is that of a source file */
 static BOOL
-issrcfile(char *path)
+issrcfile(char *file)
 {
-	struct	stat	statstruct;
-	char	*file = mybasename(path);
 	char	*s = strrchr(file, '.');
 	BOOL looks_like_source = NO;
 
@@ -570,15 +714,7 @@ issrcfile(char *path)
 		looks_like_source = YES;
 	}
 
-	if (looks_like_source != YES)
-		return NO;
-	
-	/* make sure it is a file */
-	if (lstat(path, &statstruct) == 0 && 
-	    S_ISREG(statstruct.st_mode)) {
-		return(YES);
-	}
-	return NO;
+	return(looks_like_source);
 }
 
 
@@ -588,10 +724,22 @@ incfile(char *file, char *type)
 {
     char    name[PATHLEN + 1];
     char    path[PATHLEN + 1];
+    char    **slot;
     char    *s;
     unsigned int i;
 
     assert(file != NULL); /* should never happen, but let's make sure anyway */
+    /* resolve each #include of a file at most once: the first time
+       either adds it to the source file list or finds it nowhere */
+    if (strlen(file) < PATHLEN) {
+	name[0] = type[0];
+	strcpy(name + 1, file);
+	if (*(slot = findname(&includes, name)) != NULL) {
+	    return;
+	}
+	*slot = my_strdup(name);
+	++includes.count;
+    }
     /* see if the file is already in the source file list */
     if (infilelist(file) == YES) {
 	return;
@@ -628,16 +776,111 @@ incfile(char *file, char *type)
 BOOL
 infilelist(char *path)
 {
-    struct listitem *p;
+    return(*findname(&srcnames, compath(path)) != NULL ? YES : NO);
+}
 
-    for (p = srcnames[hash(compath(path)) % HASHMOD];
-	 p != NULL;
-	 p = p->next) {
-	if (strequal(path, p->text)) {
-	    return(YES);
+/* find the hash table slot of a name, or the empty slot where it
+   belongs.  The table is grown first if adding the name would make it
+   more than half full */
+
+char **
+findname(NAMETABLE *table, char *name)
+{
+    char    **slot;
+    unsigned long h;
+
+    if (table->names == NULL) {
+	table->size = SRCHASHINIT;
+	table->names = mymalloc(table->size * sizeof(*table->names));
+	memset(table->names, 0, table->size * sizeof(*table->names));
+    } else if ((table->count + 1) * 2 > table->size) {
+	rehashnames(table);
+    }
+    ++table->lookups;
+    for (h = pathhash(name); ; ++h) {
+	++table->probes;
+	slot = &table->names[h & (table->size - 1)];
+	if (*slot == NULL || strequal(name, *slot)) {
+	    return(slot);
+	}
+    }
+}
+
+/* double a name hash table and put the names back in it */
+
+static void
+rehashnames(NAMETABLE *table)
+{
+    char    **old = table->names;
+    unsigned long oldsize = table->size;
+    unsigned long h;
+    unsigned long i;
+
+    table->size *= 2;
+    table->names = mymalloc(table->size * sizeof(*table->names));
+    memset(table->names, 0, table->size * sizeof(*table->names));
+    for (i = 0; i < oldsize; ++i) {
+	if (old[i] == NULL) {
+	    continue;
+	}
+	for (h = pathhash(old[i]);
+	     table->names[h & (table->size - 1)] != NULL; ++h) {
+	    ;
+	}
+	table->names[h & (table->size - 1)] = old[i];
+    }
+    free(old);
+}
+
+/* empty a name hash table, freeing its names if it has its own copies */
+
+void
+freenames(NAMETABLE *table, BOOL strings)
+{
+    unsigned long i;
+
+    if (strings == YES) {
+	for (i = 0; i < table->size; ++i) {
+	    free(table->names[i]);
 	}
     }
-    return(NO);
+    free(table->names);
+    table->names = NULL;
+    table->size = 0;
+    table->count = 0;
+}
+
+/* form the hash value of a file name */
+
+static unsigned long
+pathhash(char *path)
+{
+    unsigned char *s = (unsigned char *) path;
+    unsigned long h = 0;
+
+    while (*s != '\0') {
+	h = h * 31 + *s++;
+    }
+    return(h ^ (h >> 16));
+}
+
+/* report how full the file name hash table is and how many slots a
+   lookup compares */
+
+void
+srcnamestats(void)
+{
+    char    msg[MSGLEN + 1];
+
+    if (srcnames.lookups == 0) {
+	return;
+    }
+    snprintf(msg, sizeof(msg),
+	     "cscope: %lu file names in %lu hash slots, load %.2f, %.2f probes per lookup",
+	     srcnames.count, srcnames.size,
+	     (double) srcnames.count / srcnames.size,
+	     (double) srcnames.probes / srcnames.lookups);
+    postmsg(msg);
 }
 
 
@@ -692,21 +935,35 @@ inviewpath(char *file)
 void
 addsrcfile(char *path)
 {
-	struct	listitem *p;
-	int	i;
+	char	**slot;
 	
 	/* make sure there is room for the file */
 	if (nsrcfiles == msrcfiles) {
 		msrcfiles += SRCINC;
 		srcfiles = myrealloc(srcfiles, msrcfiles * sizeof(*srcfiles));
 	}
-	/* add the file to the list */
-	srcfiles[nsrcfiles++] = my_strdup(compath(path));
-	p = mymalloc(sizeof(*p));
-	p->text = my_strdup(compath(path));
-	i = hash(p->text) % HASHMOD;
-	p->next = srcnames[i];
-	srcnames[i] = p;
+	/* add the file to the list, and its name to the table */
+	path = compath(path);
+	srcfiles[nsrcfiles++] = my_strdup(path);
+	if (*(slot = findname(&srcnames, path)) == NULL) {
+		*slot = srcfiles[nsrcfiles - 1];
+		++srcnames.count;
+	}
+}
+
+/* treat a file as in the list without adding it, so an #include of
+   it is left to the cross-reference shard whose file it is.  The name
+   must last until the list is freed */
+
+void
+skipsrcfile(char *path)
+{
+	char	**slot;
+
+	if (*(slot = findname(&srcnames, path)) == NULL) {
+		*slot = path;
+		++srcnames.count;
+	}
 }
 
 /* free the memory allocated for the source file list */
@@ -714,9 +971,6 @@ addsrcfile(char *path)
 void
 freefilelist(void)
 {
-	struct	listitem *p, *nextp;
-	int	i;
-
 	/* if '-d' option is used a string space block is allocated */	
 	if (isuptodate == NO) {
 		while (nsrcfiles > 0) {
@@ -734,13 +988,15 @@ freefilelist(void)
 	msrcfiles = 0;
 	srcfiles=0;
 	
-	for (i = 0; i < HASHMOD; ++i) {
-		for (p = srcnames[i]; p != NULL; p = nextp) {
-			/* HBB 20000421: avoid memory leak */
-			free(p->text);
-			nextp = p->next;
-			free(p);
-		}
-		srcnames[i] = NULL;
-	}
+	/* the table's names were the list's */
+	freenames(&srcnames, NO);
+	freeincludes();
+}
+
+/* forget the #include files resolved, so they are looked for again */
+
+void
+freeincludes(void)
+{
+	freenames(&includes, YES);
 }
@@ -38,6 +38,7 @@
 #include "global.h"
 #include "build.h"
 #include "alloc.h"
+#include "shard.h"
 
 #ifdef CCS
 #include "sgs.h"	/* ESG_PKG and ESG_REL */
@@ -102,7 +103,7 @@ static	struct	{		/* text of input fields */
 	char	*text1;
 	char	*text2;
 	FP	findfcn;
-} fields[FIELDS + 1] = {	/* samuel has a search that is not part of the cscope display */
+} fields[FIELDS + 2] = {	/* samuel and line mode have searches that are not part of the cscope display */
 	{"Find this", "C symbol",			findsymbol},
 	{"Find this", "global definition",		finddef},
 	{"Find", "functions called by this function",	findcalledby},
@@ -114,6 +115,7 @@ static	struct	{		/* text of input fields */
 	{"Find", "files #including this file",		findinclude},
 	{"Find", "assignments to this symbol", 		findassign},
 	{"Find all", "function definitions",		findallfcns},	/* samuel only */
+	{"Find the", "definitions in these files",	findoutline},	/* line mode only */
 };
 
 /* Internal prototypes: */
@@ -407,6 +409,35 @@ jumpback(int sig)
 	siglongjmp(env, 1);
 }
 
+/* run the current field's find function on the open database,
+   writing the global references to refsfound and the non-global ones
+   to nonglobalrefs, and return its result */
+
+char *
+findrefs(FINDINIT *rc, BOOL *funcexist)
+{
+	char	*findresult = NULL;	/* find function output */
+	FP	f = fields[field].findfcn; /* searching function */
+
+	if (f == findregexp || f == findstring) {
+		initsubset();	/* mark the files to search */
+		findresult = (*f)(Pattern);
+	} else if ((*rc = findinit(Pattern)) == NOERROR) {
+		initsubset();
+		if (searchjobs(f) == NO) {
+			(void) dbseek(0L); /* read the first block */
+			findresult = (*f)(Pattern);
+		}
+		if (f == findcalledby) {
+			/* its result is a flag, not a message */
+			*funcexist = (*findresult == 'y');
+			findresult = NULL;
+		}
+		findcleanup();
+	}
+	return(findresult);
+}
+
 BOOL
 search(void)
 {
@@ -414,7 +445,6 @@ search(void)
 	BOOL	funcexist = YES;		/* find "function" error */
 	FINDINIT rc = NOERROR;		/* findinit return code */
 	sighandler_t savesig;		/* old value of signal */
-	FP	f;			/* searching function */
 	int	c;
 	
 	/* open the references found file for writing */
@@ -429,34 +459,25 @@ search(void)
 	savesig = signal(SIGINT, jumpback);
         noraw(); /* allow ctrl-c to interrupt search */
 	if (sigsetjmp(env, 1) == 0) {
-		f = fields[field].findfcn;
-		if (f == findregexp || f == findstring) {
-			findresult = (*f)(Pattern);
+		if ((nonglobalrefs = myfopen(temp2, "wb")) == NULL) {
+			cannotopen(temp2);
+			return(NO);
+		}
+		if (sharded == YES) {
+			findresult = findshards(&rc, &funcexist);
 		} else {
-			if ((nonglobalrefs = myfopen(temp2, "wb")) == NULL) {
-				cannotopen(temp2);
-				return(NO);
-			}
-			if ((rc = findinit(Pattern)) == NOERROR) {
-				(void) dbseek(0L); /* read the first block */
-				findresult = (*f)(Pattern);
-				if (f == findcalledby) 
-					funcexist = (*findresult == 'y');
-				findcleanup();
-
-				/* append the non-global references */
-				(void) fclose(nonglobalrefs);
-				if ((nonglobalrefs = myfopen(temp2, "rb"))
-				     == NULL) {
-					cannotopen(temp2);
-					return(NO);
-				}
-				while ((c = getc(nonglobalrefs)) != EOF) {
-					(void) putc(c, refsfound);
-				}
-			}
-			(void) fclose(nonglobalrefs);
+			findresult = findrefs(&rc, &funcexist);
+		}
+		/* append the non-global references */
+		(void) fclose(nonglobalrefs);
+		if ((nonglobalrefs = myfopen(temp2, "rb")) == NULL) {
+			cannotopen(temp2);
+			return(NO);
+		}
+		while ((c = getc(nonglobalrefs)) != EOF) {
+			(void) putc(c, refsfound);
 		}
+		(void) fclose(nonglobalrefs);
 	}
         raw(); /* return to raw mode */
 	signal(SIGINT, savesig);
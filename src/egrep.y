@@ -46,28 +46,55 @@
 
 %{
 #include "global.h"
+#include "alloc.h"
 #include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <setjmp.h>	/* jmp_buf */
 
 #define nextch()	(*input++)
 
-#define MAXLIN 350
-#define MAXPOS 4000
+#define MAXLIN (4 * PATLEN)
 #define NCHARS 256
-#define NSTATES 128
+#define DFASTATES 1024		/* most DFA states to keep by default */
+#define MINDFASTATES 4		/* fewest allowed, for the start states */
+#define MAXDFASTATES SHRT_MAX	/* most allowed, as transitions are shorts */
+#define NOSTATE -1		/* transition not made yet */
 #define FINAL -1
-static	char gotofn[NSTATES][NCHARS];
-static	int state[NSTATES];
-static	char out[NSTATES];
+#define EGREPMAPSIZE	(64 * 1024)	/* smallest file to map */
+
+/* the DFA states are made as the search needs them; when there would
+   be more than dfastates, all but the start states are dropped, so a
+   pattern of any size can be searched for */
+static	short (*gotofn)[NCHARS];	/* each state's transitions */
+static	int *state;		/* each state's positions */
+static	char *out;		/* each state is a match */
+static	int nstates;		/* number of states */
+static	int maxstates;		/* number allocated */
+static	int istate;		/* state at the start of a line */
+static	int dfastates;		/* most states to keep, CSCOPE_DFA_STATES */
+
+/* the longest string that every matching line contains, to find the
+   lines that can match with memmem() before running the DFA */
+static	char must[MAXLIN];
+static	int mustlen;
+static	int mustshift[NCHARS];	/* Horspool shifts for caseless search */
+static	int literal;		/* the pattern is just the string */
+static	char run[MAXLIN];	/* string of the current concatenation */
+static	int runlen;
 static	unsigned int line;
 static	int name[MAXLIN];
 static	unsigned int left[MAXLIN];
 static	unsigned int right[MAXLIN];
 static	unsigned int parent[MAXLIN];
 static	int foll[MAXLIN];
-static	int positions[MAXPOS];
+static	int *positions;
+static	int maxpos;
+static	int follpos;		/* end of the follow positions */
 static	char chars[MAXLIN];
 static	int nxtpos;
 static	int nxtchar;
@@ -84,7 +111,13 @@ static	char *message;	/* error message */
 
 /* Internal prototypes: */
 static	void cfoll(int v);
-static	void cgotofn(void);
+static	void dfainit(void);
+static	void findmust(unsigned int v);
+static	void endrun(void);
+static	int onlychars(unsigned int v);
+static	char *findstr(char *p, char *end);
+static	int newstate(void);
+static	int nextstate(int s, int c);
 static	int cstate(int v);
 static	int member(int symb, int set, int torf);
 static	int notin(int n);
@@ -303,16 +336,12 @@ cfoll(int v)
     }
 }
 
+/* make the start state, which has the first positions of the pattern */
+
 static void
-cgotofn(void)
+dfainit(void)
 {
-    unsigned int i, n, s;
-    int c, k;
-    char symbol[NCHARS];
-    unsigned int j, l, pc, pos;
-    unsigned int nc;
-    int curpos;
-    unsigned int num, number, newpos;
+    unsigned int n;
 
     count = 0;
     for (n=3; n<=line; n++)
@@ -320,95 +349,193 @@ cgotofn(void)
     if (cstate(line-1)==0) {
 	tmpstat[line] = 1;
 	count++;
-	out[0] = 1;
     }
     for (n=3; n<=line; n++)
 	initstat[n] = tmpstat[n];
     count--;		/*leave out position 1 */
     icount = count;
     tmpstat[1] = 0;
-    add(state, 0);
-    n = 0;
-    for (s = 0; s <= n; s++)  {
-	if (out[s] == 1)
-	    continue;
-	for (i = 0; i < NCHARS; i++)
-	    symbol[i] = 0;
-	num = positions[state[s]];
-	count = icount;
-	for (i = 3; i <= line; i++)
-	    tmpstat[i] = initstat[i];
-	pos = state[s] + 1;
-	for (i = 0; i < num; i++) {
-	    curpos = positions[pos];
-	    if ((c = name[curpos]) >= 0) {
-		if (c < NCHARS) {
-		    symbol[c] = 1;
-		} else if (c == DOT) {
-		    for (k = 0; k < NCHARS; k++)
-			if (k != '\n')
-			    symbol[k] = 1;
-		} else if (c == CCL) {
-		    nc = chars[right[curpos]];
-		    pc = right[curpos] + 1;
-		    for (j = 0; j < nc; j++)
-			symbol[(unsigned char)chars[pc++]] = 1;
-		} else if (c == NCCL) {
-		    nc = chars[right[curpos]];
-		    for (j = 0; j < NCHARS; j++) {
-			pc = right[curpos] + 1;
-			for (l = 0; l < nc; l++)
-			    if (j==(unsigned char)chars[pc++])
-				goto cont;
-			if (j != '\n')
-			    symbol[j] = 1;
-		    cont:
-			;
+    follpos = nxtpos;
+    nstates = 0;
+    (void) newstate();
+    /* if the pattern matches an empty line, every line matches */
+    istate = out[0] ? 0 : nextstate(0, '\n');
+}
+
+/* find the characters that concatenation v must match one after the
+   other, and keep the longest string of them */
+
+static void
+findmust(unsigned int v)
+{
+    int c;
+
+    if (name[v] == CAT) {
+	findmust(left[v]);
+	findmust(right[v]);
+	return;
+    }
+    /* a character, or a character that can repeat */
+    c = name[v] == PLUS ? name[left[v]] : name[v];
+    if ((name[v] == PLUS ? left[left[v]] : left[v]) == 0
+	&& c > 0 && c < NCHARS && c != '\n') {
+	run[runlen++] = c;
+	if (name[v] != PLUS) {
+	    return;
+	}
+    }
+    endrun();
+}
+
+/* end the string of the concatenation */
+
+static void
+endrun(void)
+{
+    if (runlen > mustlen) {
+	memcpy(must, run, runlen);
+	mustlen = runlen;
+    }
+    runlen = 0;
+}
+
+/* see if v matches only a string of characters */
+
+static int
+onlychars(unsigned int v)
+{
+    if (name[v] == CAT) {
+	return(onlychars(left[v]) && onlychars(right[v]));
+    }
+    return(left[v] == 0 && name[v] > 0 && name[v] < NCHARS
+	   && name[v] != '\n');
+}
+
+/* find the next copy of the string that a matching line must contain;
+   memmem() finds it as is, and a Horspool search finds it with the
+   text in lower case for the -i option */
+
+static char *
+findstr(char *p, char *end)
+{
+    char *last;
+    int i;
+
+    if (!iflag) {
+	return(memmem(p, end - p, must, mustlen));
+    }
+    for (last = p + mustlen - 1; last < end;
+	 last += mustshift[tolower((unsigned char) *last)]) {
+	for (i = 0; tolower((unsigned char) last[-i])
+		 == (unsigned char) must[mustlen - 1 - i]; ) {
+	    if (++i == mustlen) {
+		return(last - mustlen + 1);
+	    }
+	}
+    }
+    return(NULL);
+}
+
+/* add the state with the positions in tmpstat */
+
+static int
+newstate(void)
+{
+    int n;
+
+    if (nstates == maxstates) {
+	maxstates = maxstates == 0 ? 32 : 2 * maxstates;
+	gotofn = myrealloc(gotofn, maxstates * sizeof(*gotofn));
+	state = myrealloc(state, maxstates * sizeof(*state));
+	out = myrealloc(out, maxstates * sizeof(*out));
+    }
+    n = nstates++;
+    add(state, n);
+    out[n] = tmpstat[line] == 1;
+    memset(gotofn[n], 0xff, sizeof(*gotofn));	/* all NOSTATE */
+    return(n);
+}
+
+/* make the transition from state s on character c */
+
+static int
+nextstate(int s, int c)
+{
+    unsigned int i, j, pos;
+    int curpos, k;
+    unsigned int num, number, newpos;
+    int save[MAXLIN];
+    int savecount;
+    BOOL symbol = NO;
+
+    /* the characters that no position of the state expects go back to
+       the start state */
+    num = positions[state[s]];
+    pos = state[s] + 1;
+    for (i = 0; i < num && symbol == NO; i++) {
+	curpos = positions[pos++];
+	if ((k = name[curpos]) >= 0) {
+	    if (k < NCHARS) {
+		symbol = k == c;
+	    } else if (k == DOT) {
+		symbol = c != '\n';
+	    } else if (k == CCL) {
+		symbol = member(c, right[curpos], 1);
+	    } else if (k == NCCL) {
+		symbol = c != '\n' && member(c, right[curpos], 0);
+	    }
+	}
+    }
+    if (symbol == NO) {
+	return(gotofn[s][c] = 0);
+    }
+    count = icount;
+    for (i=3; i <= line; i++)
+	tmpstat[i] = initstat[i];
+    pos = state[s] + 1;
+    for (i=0; i<num; i++) {
+	curpos = positions[pos];
+	if ((k = name[curpos]) >= 0)
+	    if ((k == c)
+		|| (k == DOT)
+		|| (k == CCL && member(c, right[curpos], 1))
+		|| (k == NCCL && member(c, right[curpos], 0))
+		) {
+		number = positions[foll[curpos]];
+		newpos = foll[curpos] + 1;
+		for (j = 0; j < number; j++) {
+		    if (tmpstat[positions[newpos]] != 1) {
+			tmpstat[positions[newpos]] = 1;
+			count++;
 		    }
+		    newpos++;
 		}
 	    }
-	    pos++;
-	} /* for (i) */
-	for (c=0; c<NCHARS; c++) {
-	    if (symbol[c] == 1) {
-		/* nextstate(s,c) */
-		count = icount;
-		for (i=3; i <= line; i++)
-		    tmpstat[i] = initstat[i];
-		pos = state[s] + 1;
-		for (i=0; i<num; i++) {
-		    curpos = positions[pos];
-		    if ((k = name[curpos]) >= 0)
-			if ((k == c)
-			    || (k == DOT)
-			    || (k == CCL && member(c, right[curpos], 1))
-			    || (k == NCCL && member(c, right[curpos], 0))
-			    ) {
-			    number = positions[foll[curpos]];
-			    newpos = foll[curpos] + 1;
-			    for (j = 0; j < number; j++) {
-				if (tmpstat[positions[newpos]] != 1) {
-				    tmpstat[positions[newpos]] = 1;
-				    count++;
-				}
-				newpos++;
-			    }
-			}
-		    pos++;
-		} /* end nextstate */
-		if (notin(n)) {
-		    if (n >= NSTATES)
-			overflo();
-		    add(state, ++n);
-		    if (tmpstat[line] == 1)
-			out[n] = 1;
-		    gotofn[s][c] = n;
-		} else {
-		    gotofn[s][c] = xstate;
-		}
-	    } /* if (symbol) */
-	} /* for(c) */
-    } /* for(s) */
+	pos++;
+    }
+    if (!notin(nstates - 1)) {
+	return(gotofn[s][c] = xstate);
+    }
+    if (nstates < dfastates) {
+	return(gotofn[s][c] = newstate());
+    }
+    /* drop the states, keeping the new one's positions, and make the
+       start states again */
+    for (i = 3; i <= line; i++)
+	save[i] = tmpstat[i];
+    savecount = count;
+    count = icount;
+    for (i = 3; i <= line; i++)
+	tmpstat[i] = initstat[i];
+    nxtpos = follpos;
+    nstates = 0;
+    (void) newstate();
+    for (i = 3; i <= line; i++)
+	tmpstat[i] = save[i];
+    count = savecount;
+    s = newstate();
+    istate = nextstate(0, '\n');
+    return(s);
 }
 
 static int
@@ -473,8 +600,10 @@ add(int *array, int n)
 {
     unsigned int i;
 
-    if (nxtpos + count > MAXPOS)
-	overflo();
+    if (nxtpos + count + 1 > maxpos) {
+	maxpos = 2 * (nxtpos + count + 1);
+	positions = myrealloc(positions, maxpos * sizeof(*positions));
+    }
     array[n] = nxtpos;
     positions[nxtpos++] = count;
     for (i=3; i <= line; i++) {
@@ -523,17 +652,23 @@ follow(unsigned int v)
 char *
 egrepinit(char *egreppat)
 {
+    char *s;
+    int i;
+
+    /* a pattern that needs many states may be searched faster with a
+       larger state cache, at the cost of its memory */
+    dfastates = DFASTATES;
+    if ((s = getenv("CSCOPE_DFA_STATES")) != NULL
+	&& (i = atoi(s)) >= MINDFASTATES && i <= MAXDFASTATES) {
+	dfastates = i;
+    }
     /* initialize the global data */
-    memset(gotofn, 0, sizeof(gotofn));
-    memset(state, 0, sizeof(state));
-    memset(out, 0, sizeof(out));
     line = 1;
     memset(name, 0, sizeof(name));
     memset(left, 0, sizeof(left));
     memset(right, 0, sizeof(right));
     memset(parent, 0, sizeof(parent));
     memset(foll, 0, sizeof(foll));
-    memset(positions, 0, sizeof(positions));
     memset(chars, 0, sizeof(chars));
     nxtpos = 0;
     nxtchar = 0;
@@ -547,114 +682,126 @@ egrepinit(char *egreppat)
     if (setjmp(env) == 0) {
 	yyparse();
 	cfoll(line-1);
-	cgotofn();
+	dfainit();
+	mustlen = runlen = 0;
+	findmust(left[line]);
+	endrun();
+	literal = onlychars(right[left[line]]);
+	for (i = 0; i < NCHARS; i++)
+	    mustshift[i] = mustlen;
+	for (i = 0; i + 1 < mustlen; i++)
+	    mustshift[(unsigned char) must[i]] = mustlen - 1 - i;
     }
     return(message);
 }
 
-static char buf[2 * BUFSIZ];
-static const char *buf_end = buf + (sizeof(buf) / sizeof(*buf));
+/* output the lines from p to end that match the expression */
 
-static size_t read_next_chunk(char **p, FILE *fptr)
+static void
+egrepbuf(char *file, char *p, char *end, FILE *output, char *format)
 {
-    if (*p <= (buf + BUFSIZ)) {
-        /* bwlow the middle, so enough space left for one entire BUFSIZ */
-	return fread(*p, sizeof(**p), BUFSIZ, fptr);
-    } else if (*p == buf_end) {
-        /* exactly at end ... wrap around and use lower half */
-	*p = buf;
-	return fread(*p, sizeof(**p), BUFSIZ, fptr);
+    char *nlp;
+    short (*go)[NCHARS] = gotofn;	/* held here for speed */
+    char *match = out;
+    char *skip;
+    int cstat;
+    int nstat;
+    unsigned char c;
+
+    lnum = 1;
+    nlp = p;
+    cstat = istate;
+    while (p < end) {
+	/* at the start of a line, go to the line with the next copy of
+	   the string that a matching line must contain */
+	if (p == nlp && mustlen > 0) {
+	    if ((skip = findstr(p, end)) == NULL) {
+		break;
+	    }
+	    while ((p = memchr(p, '\n', skip - p)) != NULL) {
+		lnum++;
+		nlp = ++p;
+	    }
+	    /* if the pattern is just the string, that line matches */
+	    p = literal ? skip : nlp;
+	}
+	if (!literal && match[cstat] == 0) {
+	    /* all input chars made positive */
+	    c = (unsigned char) *p++;
+	    if (iflag) {
+		/* for -i option*/
+		c = tolower(c);
+	    }
+	    if ((nstat = go[cstat][c]) == NOSTATE) {
+		nstat = nextstate(cstat, c);
+		go = gotofn;
+		match = out;
+	    }
+	    cstat = nstat;
+	    if (match[cstat] == 0) {
+		if (c == '\n') {
+		    lnum++;
+		    nlp = p;
+		    cstat = istate;
+		}
+		continue;
+	    }
+	    if (c == '\n') {
+		--p;	/* the line ends at this newline */
+	    }
+	}
+	/* output the matching line, and go on at the next one */
+	if ((p = memchr(p, '\n', end - p)) == NULL) {
+	    p = end;
+	} else {
+	    ++p;
+	}
+	fprintf(output, format, file, lnum);
+	fwrite(nlp, 1, p - nlp, output);
+	lnum++;
+	nlp = p;
+	cstat = istate;
     }
-    /* somewhere in second half, so do a limited read */
-    return fread(*p, sizeof(**p), buf_end - *p, fptr);
 }
 
 int
 egrep(char *file, FILE *output, char *format)
 {
-    char *p;
-    unsigned int cstat;
-    int ccount;
-    char *nlp;
-    unsigned int istat;
-    int in_line;
-    FILE *fptr;
-
-    if ((fptr = myfopen(file, "r")) == NULL) 
+    static char *text;		/* file text buffer */
+    static size_t textsize;	/* its size */
+    struct stat statstruct;
+    char *map;
+    size_t size;
+    ssize_t n;
+    int fd;
+
+    if ((fd = myopen(file, O_RDONLY, 0)) == -1) 
 	return(-1);
 
-    lnum = 1;
-    p = buf;
-    nlp = p;
-    ccount = read_next_chunk(&p, fptr);
-
-    if (ccount <= 0) {
-	fclose(fptr);
+    /* search a large file through a read-only mapping; mapping costs
+       more than reading a small file */
+    if (fstat(fd, &statstruct) == 0 && S_ISREG(statstruct.st_mode)
+	&& statstruct.st_size >= EGREPMAPSIZE
+	&& (map = mmap(NULL, statstruct.st_size, PROT_READ, MAP_PRIVATE,
+		       fd, 0)) != MAP_FAILED) {
+	egrepbuf(file, map, map + statstruct.st_size, output, format);
+	munmap(map, statstruct.st_size);
+	close(fd);
 	return(0);
     }
-    in_line = 1;
-    istat = cstat = (unsigned int) gotofn[0]['\n'];
-    if (out[cstat])
-	goto found;
-    for (;;) {
-	if (!iflag) {
-	    /* all input chars made positive */
-	    cstat = (unsigned int) gotofn[cstat][(unsigned char)*p];
-	} else {
-	    /* for -i option*/
-	    cstat = (unsigned int) gotofn[cstat][tolower((unsigned char)*p)];
-        }
-	if (out[cstat]) {
-	found:
-	    for(;;) {
-		if (*p++ == '\n') {
-		    in_line = 0;
-		succeed:
-		    fprintf(output, format, file, lnum);
-		    if (p <= nlp) {
-			while (nlp < buf_end)
-			    putc(*nlp++, output);
-			nlp = buf;
-		    }
-		    while (nlp < p)
-			putc(*nlp++, output);
-		    lnum++;
-		    nlp = p;
-		    if (out[cstat = istat] == 0)
-			goto brk2;
-		} /* if (p++ == \n) */
-	    cfound:
-		if (--ccount <= 0) {
-		    ccount = read_next_chunk(&p, fptr);
-		    if (ccount <= 0) {
-			if (in_line) {
-			    in_line = 0;
-			    goto succeed;
-			}
-                        fclose(fptr);
-                        return(0);
-		    }
-		} /* if(ccount <= 0) */
-		in_line = 1;
-	    } /* for(ever) */
-	} /* if(out[cstat]) */
-
-	if (*p++ == '\n') {
-	    in_line = 0;
-	    lnum++;
-	    nlp = p;
-	    if (out[(cstat=istat)])
-		goto cfound;
+    /* read all of the file into the buffer */
+    size = 0;
+    do {
+	if (size == textsize) {
+	    textsize += 16 * BUFSIZ;
+	    text = myrealloc(text, textsize);
 	}
-    brk2:
-	if (--ccount <= 0) {
-	    ccount = read_next_chunk(&p, fptr);
-	    if (ccount <= 0) 
-		break;
+	if ((n = read(fd, text + size, textsize - size)) > 0) {
+	    size += n;
 	}
-	in_line = 1;
-    }
-    fclose(fptr);
+    } while (n > 0);
+    egrepbuf(file, text, text + size, output, format);
+    close(fd);
     return(0);
 }
 
@@ -682,3 +829,13 @@ egrepcaseless(int i)
 {
 	iflag = i;	/* simulate "egrep -i" */
 }
+
+/* return the string that a line matching the expression must contain
+   and set its length, which is 0 if there is none */
+
+char *
+egrepmust(int *length)
+{
+	*length = mustlen;
+	return(must);
+}
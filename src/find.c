@@ -37,8 +37,12 @@
 
 #include "global.h"
 
+#include "alloc.h"
+#include "blocks.h"
 #include "build.h"
+#include "jobs.h"
 #include "scanner.h"		/* for token definitions */
+#include "trigram.h"
 
 #include <assert.h>
 #if defined(USE_NCURSES) && !defined(RENAMED_NCURSES)
@@ -47,6 +51,10 @@
 #include <curses.h>
 #endif
 #include <regex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define	SEARCHTASKS	4	/* search tasks per job */
 
 static char const rcsid[] = "$Id: find.c,v 1.27 2014/11/20 21:12:54 broeker Exp $";
 
@@ -63,6 +71,9 @@ char	block[BUFSIZ + 2];		/* leave room for end-of-block mark */
 int	blocklen;			/* length of disk block read */
 char	blockmark;			/* mark character to be searched for */
 long	blocknumber;			/* block number */
+static	char	*dbmap;			/* the mapped cross-reference, or NULL */
+static	long	dbmapsize;		/* its size */
+char	*subset;			/* --subset file name pattern, or NULL */
 
 static	char	global[] = "<global>";	/* dummy global function name */
 static	char	cpattern[PATLEN + 1];	/* compressed pattern */
@@ -71,19 +82,34 @@ static	POSTING	*postingp;		/* retrieved posting set pointer */
 static	long	postingsfound;		/* retrieved number of postings */
 static	regex_t regexp;			/* regular expression */
 static	BOOL	isregexp_valid = NO;	/* regular expression status */
+static	char	must[PATLEN + 1];	/* string a regexp match contains */
+static	regex_t	subsetexp;		/* --subset regular expression */
+static	char	*wanted;		/* each source file to search, or NULL */
+static	long	cursegment;		/* next file segment */
+static	char	*(*taskfcn)(char *);	/* search job tasks' find function */
+static	long	*tasksegment;		/* first file segment of each task */
+static	unsigned long egreptasks;	/* number of egrep job tasks */
 
 static	BOOL	match(void);
+static	BOOL	regexpmatch(char *s);
+static	void	findmust(char *pattern);
 static	BOOL	matchrest(void);
 static	POSTING	*getposting(void);
 static	char	*lcasify(char *s);
 static	void	findcalledbysub(char *file, BOOL macro);
 static	void	findterm(char *pattern);
+static	BOOL	filewanted(char *file);
 static	void	putline(FILE *output);
 static  char    *find_symbol_or_assignment(char *pattern, BOOL assign_flag);
 static  BOOL    check_for_assignment(void);
 static	void	putpostingref(POSTING *p, char *pat);
 static	void	putref(int seemore, char *file, char *func);
 static	void	putsource(int seemore, FILE *output);
+static	BOOL	skipfile(char *file);
+static	BOOL	searchtask(int task, void *arg);
+static	BOOL	egreptask(int task, void *arg);
+static	void	egrepfiles(unsigned int first, unsigned int last);
+static	void	appendjobfile(int task, char *suffix, FILE *output);
 
 /* find the symbol in the cross-reference */
 
@@ -195,6 +221,7 @@ find_symbol_or_assignment(char *pattern, BOOL assign_flag)
 	fetch_string_from_dbase(file, sizeof(file));
 	strcpy(function, global); /* set the dummy global function name */
 	strcpy(macro, global);	/* set the dummy global macro name */
+	(void) skipfile(file);
 	
 	/* find the next symbol */
 	/* note: this code was expanded in-line for speed */
@@ -231,6 +258,9 @@ find_symbol_or_assignment(char *pattern, BOOL assign_flag)
 					return NULL;
 				}
 				progress("Search", searchcount, nsrcfiles);
+				if (skipfile(file) == YES) {
+					goto notmatched;
+				}
 				/* FALLTHROUGH */
 				
 			case FCNEND:		/* function end */
@@ -273,7 +303,7 @@ find_symbol_or_assignment(char *pattern, BOOL assign_flag)
 				if (caseless == YES) {
 					s = lcasify(s);
 				}
-				if (*s != '\0' && regexec (&regexp, s, (size_t)0, NULL, 0) == 0) { 
+				if (*s != '\0' && regexpmatch(s) == YES) { 
 					goto matched;
 				}
 			}
@@ -313,7 +343,7 @@ find_symbol_or_assignment(char *pattern, BOOL assign_flag)
 				}
 				
 				/* match the symbol to the regular expression */
-				if (*s != '\0' && regexec (&regexp, s, (size_t)0, NULL, 0) == 0) {
+				if (*s != '\0' && regexpmatch(s) == YES) {
 					goto matched;
 				}
 				goto notmatched;
@@ -399,6 +429,7 @@ finddef(char *pattern)
 				return NULL;
 			}
 			progress("Search", searchcount, nsrcfiles);
+			(void) skipfile(file);
 			break;
 
 		case DEFINE:		/* could be a macro */
@@ -443,6 +474,7 @@ findallfcns(char *dummy)
 				return NULL;
 			}
 			progress("Search", searchcount, nsrcfiles);
+			(void) skipfile(file);
 			/* FALLTHROUGH */
 			
 		case FCNEND:		/* function end */
@@ -462,6 +494,50 @@ findallfcns(char *dummy)
 	return NULL;
 }
 
+/* find the definitions in the files matching this pattern, in file order */
+
+char *
+findoutline(char *pattern)
+{
+	char	file[PATHLEN + 1];	/* source file name */
+	char	symbol[PATLEN + 1];	/* symbol name */
+
+	(void) pattern;		/* file names matched by initsubset() */
+
+	/* find the next file name or definition */
+	while (scanpast('\t') != NULL) {
+		switch (*blockp) {
+			
+		case NEWFILE:
+			skiprefchar();	/* save file name */
+			fetch_string_from_dbase(file, sizeof(file));
+			if (*file == '\0') {	/* if end of symbols */
+				return NULL;
+			}
+			progress("Search", searchcount, nsrcfiles);
+			(void) skipfile(file);
+			break;
+
+		case DEFINE:		/* could be a macro */
+		case FCNDEF:
+		case CLASSDEF:
+		case ENUMDEF:
+		case MEMBERDEF:
+		case STRUCTDEF:
+		case TYPEDEF:
+		case UNIONDEF:
+		case GLOBALDEF:		/* other global definition */
+			skiprefchar();	/* save its name */
+			fetch_string_from_dbase(symbol, sizeof(symbol));
+
+			/* output the file, definition and source line */
+			putref(0, file, symbol);
+			break;
+		}
+	}
+	return NULL;
+}
+
 /* find the functions calling this function */
 
 char *
@@ -471,7 +547,7 @@ findcalling(char *pattern)
 	char	function[PATLEN + 1];	/* function name */
 	char	tmpfunc[10][PATLEN + 1];/* 10 temporary function names */
 	char	macro[PATLEN + 1];	/* macro name */
-	char	*tmpblockp;
+	long	tmpoffset;
 	int	morefuns, i;
 
 	if (invertedindex == YES) {
@@ -487,7 +563,6 @@ findcalling(char *pattern)
 	}
 	/* find the next file name or function definition */
 	*macro = '\0';	/* a macro can be inside a function, but not vice versa */
-	tmpblockp = 0;
 	morefuns = 0;	/* one function definition is normal case */
 	for (i = 0; i < 10; i++) *(tmpfunc[i]) = '\0';
 	while (scanpast('\t') != NULL) {
@@ -501,6 +576,11 @@ findcalling(char *pattern)
 			}
 			progress("Search", searchcount, nsrcfiles);
 			(void) strcpy(function, global);
+			*macro = '\0';
+			for (i = 0; i < morefuns; i++)
+				*(tmpfunc[i]) = '\0';
+			morefuns = 0;
+			(void) skipfile(file);
 			break;
 			
 		case DEFINE:		/* could be a macro */
@@ -541,9 +621,13 @@ findcalling(char *pattern)
 					putref(1, file, macro);
 				}
 				else {
-					tmpblockp = blockp;
+					/* seek back to the call for each caller,
+					   as putting its source line can read the
+					   next block */
+					tmpoffset = blocknumber * BUFSIZ +
+						(blockp - block);
 					for (i = 0; i < morefuns; i++) {
-						blockp = tmpblockp;
+						(void) dbseek(tmpoffset);
 						putref(1, file, tmpfunc[i]);
 					}
 				}
@@ -583,23 +667,86 @@ findregexp(char *egreppat)
 {
     unsigned int i;
     char *egreperror;
+    char *string;
+    char *files;
+    int length;
 
     /* compile the pattern */
     if ((egreperror = egrepinit(egreppat)) == NULL) {
 
-	/* search the files */
-	for (i = 0; i < nsrcfiles; ++i) {
-	    char *file = filepath(srcfiles[i]);
+	/* search only the files that the trigram index says may have
+	   the string that a matching line must contain */
+	string = egrepmust(&length);
+	if ((files = trigramfiles(string, length, TEXTTRIGRAMS)) != NULL) {
+	    if (wanted == NULL) {
+		wanted = files;
+	    } else {
+		for (i = 0; i < nsrcfiles; ++i) {
+		    if (files[i] == NO) {
+			wanted[i] = NO;
+		    }
+		}
+		free(files);
+	    }
+	}
 
-	    progress("Search", searchcount, nsrcfiles);
-	    if (egrep(file, refsfound, "%s <unknown> %ld ") < 0) {
-		posterr ("Cannot open file %s", file);
+	/* search parts of the files in parallel jobs, and append their
+	   matching lines in file order */
+	if (njobs > 1 && jobworker == NO && nsrcfiles > 1) {
+	    if ((egreptasks = njobs * SEARCHTASKS) > nsrcfiles) {
+		egreptasks = nsrcfiles;
 	    }
+	    if (runjobs(egreptasks, egreptask, NULL) == YES) {
+		for (i = 0; i < egreptasks; ++i) {
+		    appendjobfile(i, ".r", refsfound);
+		}
+		removejobfiles();
+		return(NULL);
+	    }
+	    removejobfiles();
 	}
+	/* search the files */
+	egrepfiles(0, nsrcfiles);
     }
     return(egreperror);
 }
 
+/* search the wanted source files from first up to last with egrep() */
+
+static void
+egrepfiles(unsigned int first, unsigned int last)
+{
+    unsigned int i;
+
+    for (i = first; i < last; ++i) {
+	char *file = filepath(srcfiles[i]);
+
+	if (wanted != NULL && wanted[i] == NO) {
+	    continue;
+	}
+	progress("Search", searchcount, nsrcfiles);
+	if (egrep(file, refsfound, "%s <unknown> %ld ") < 0) {
+	    posterr ("Cannot open file %s", file);
+	}
+    }
+}
+
+/* egrep job task: search a part of the source files, writing the
+   matching lines to the task's file */
+
+static BOOL
+egreptask(int task, void *arg)
+{
+    (void) arg;
+    signal(SIGINT, SIG_DFL);
+    if ((refsfound = myfopen(jobfile(task, ".r"), "wb")) == NULL) {
+	return(NO);
+    }
+    egrepfiles((unsigned long) nsrcfiles * task / egreptasks,
+	       (unsigned long) nsrcfiles * (task + 1) / egreptasks);
+    return(fclose(refsfound) != EOF);
+}
+
 /* find matching file names */
 
 char *
@@ -612,12 +759,15 @@ findfile(char *dummy)
     for (i = 0; i < nsrcfiles; ++i) {
 	char *s;
 
+	if (wanted != NULL && wanted[i] == NO) {
+	    continue;
+	}
 	if (caseless == YES) {
 	    s = lcasify(srcfiles[i]);
 	} else {
 	    s = srcfiles[i];
 	}
-	if (regexec (&regexp, s, (size_t)0, NULL, 0) == 0) {
+	if (regexpmatch(s) == YES) {
 	    (void) fprintf(refsfound, "%s <unknown> 1 <unknown>\n", 
 			   srcfiles[i]);
 	}
@@ -656,6 +806,7 @@ findinclude(char *pattern)
 				return NULL;
 			}
 			progress("Search", searchcount, nsrcfiles);
+			(void) skipfile(file);
 			break;
 			
 		case INCLUDE:		/* match function called to pattern */
@@ -688,6 +839,7 @@ findinit(char *pattern)
 		regfree(&regexp);
 
 	isregexp_valid = NO;
+	*must = '\0';
 
 	/* remove trailing white space */
 	for (s = pattern + strlen(pattern) - 1; 
@@ -704,11 +856,12 @@ findinit(char *pattern)
 	}
 
 	/* allow a partial match for a file name */
-	if (field == FILENAME || field == INCLUDES) {
+	if (field == FILENAME || field == INCLUDES || field == OUTLINE) {
 		if (regcomp (&regexp, pattern, REG_EXTENDED | REG_NOSUB) != 0) { 
 			return(REGCMPERROR);
 		} else {
 			isregexp_valid = YES;
+			findmust(pattern);
 		}
 		return(NOERROR);
 	}
@@ -766,6 +919,7 @@ findinit(char *pattern)
 		else
 		{
 			isregexp_valid = YES;
+			findmust(s);
 		}
 	}
 	else {
@@ -793,6 +947,166 @@ findcleanup(void)
 	/* discard any regular expression */
 }
 
+/* set the --subset pattern of the files searched, returning NO if it
+   is not a valid regular expression */
+
+BOOL
+setsubset(char *pattern)
+{
+	if (subset != NULL) {
+		regfree(&subsetexp);
+		subset = NULL;
+	}
+	if (regcomp(&subsetexp, pattern, REG_EXTENDED | REG_NOSUB) != 0) {
+		return(NO);
+	}
+	subset = pattern;
+	return(YES);
+}
+
+/* mark the source files this search is limited to, if it is limited
+   by --subset, to the files to outline, or by the trigram index to the
+   files whose names or #include lines may match */
+
+void
+initsubset(void)
+{
+	unsigned long i;
+	char	*files = NULL;	/* files the trigram index allows */
+
+	free(wanted);
+	wanted = NULL;
+	cursegment = 0;
+	if (field == FILENAME
+	    || (field == INCLUDES && invertedindex == NO)) {
+		files = trigramfiles(must, strlen(must), field == FILENAME ?
+				     NAMETRIGRAMS : REFTRIGRAMS);
+	}
+	if (subset == NULL && field != OUTLINE && files == NULL) {
+		return;
+	}
+	wanted = files != NULL ? files : mymalloc(nsrcfiles + 1);
+	for (i = 0; i < nsrcfiles; ++i) {
+		if (files == NULL || files[i] == YES) {
+			wanted[i] = filewanted(srcfiles[i]);
+		}
+	}
+	/* so whole files can be skipped in the cross-reference, which a
+	   file name search does not read */
+	if (field != FILENAME) {
+		(void) readsegments();
+	}
+}
+
+/* find the longest string of characters that a match of the regular
+   expression must contain one after the other.  Only the top level of
+   the pattern is looked at, so nothing is found in a group or if there
+   are alternatives */
+
+static void
+findmust(char *pattern)
+{
+	char	run[PATLEN + 1];	/* characters in a row */
+	int	n = 0;			/* their number */
+	int	depth = 0;		/* group nesting depth */
+	char	*s, *next;
+	char	c;
+
+	*must = '\0';
+	for (s = pattern; ; s = next) {
+		next = s + 1;
+		c = '\0';	/* not a character to match */
+		switch (*s) {
+		case '\\':
+			if (s[1] != '\0') {
+				next = s + 2;
+				if (!isalnum((unsigned char) s[1])) {
+					c = s[1];	/* escaped special char */
+				}
+			}
+			break;
+		case '[':	/* skip a bracket expression */
+			if (*next == '^') {
+				++next;
+			}
+			if (*next == ']') {
+				++next;
+			}
+			while (*next != '\0' && *next != ']') {
+				/* skip a class like [:alpha:] */
+				if (*next == '[' && next[1] != '\0' &&
+				    strchr(":.=", next[1]) != NULL &&
+				    strchr(next + 2, ']') != NULL) {
+					next = strchr(next + 2, ']');
+				}
+				++next;
+			}
+			if (*next == ']') {
+				++next;
+			}
+			break;
+		case '{':	/* skip a repeat count */
+			if ((next = strchr(s, '}')) != NULL) {
+				++next;
+			} else {
+				next = s + strlen(s);
+			}
+			break;
+		case '(':
+			++depth;
+			break;
+		case ')':
+			--depth;
+			break;
+		case '|':
+			if (depth == 0) {	/* alternatives */
+				*must = '\0';
+				return;
+			}
+			break;
+		case '\0':
+		case '.':
+		case '^':
+		case '$':
+		case '*':
+		case '+':
+		case '?':
+			break;
+		default:
+			c = *s;
+		}
+		/* add a character that is matched once to the run */
+		if (c != '\0' && depth == 0 &&
+		    (*next == '\0' || strchr("*?{", *next) == NULL)) {
+			run[n++] = c;
+			if (*next != '+') {
+				continue;
+			}
+		}
+		/* end the run */
+		run[n] = '\0';
+		if (n > (int) strlen(must)) {
+			(void) strcpy(must, run);
+		}
+		n = 0;
+		if (*s == '\0') {
+			return;
+		}
+	}
+}
+
+/* match a string to the regular expression, first checking that it
+   contains the string that every match contains */
+
+static BOOL
+regexpmatch(char *s)
+{
+	if (*must != '\0' && strstr(s, must) == NULL) {
+		return(NO);
+	}
+	return(regexec(&regexp, s, (size_t)0, NULL, 0) ? NO : YES);
+}
+
 /* match the pattern to the string */
 
 static BOOL
@@ -807,10 +1121,10 @@ match(void)
 			return(NO);
 		}
 		if (caseless == YES) {
-			return (regexec (&regexp, lcasify(string), (size_t)0, NULL, 0) ? NO : YES);
+			return(regexpmatch(lcasify(string)));
 		}
 		else {
-			return (regexec (&regexp, string, (size_t)0, NULL, 0) ? NO : YES);
+			return(regexpmatch(string));
 		}
 	}
 	/* it is a string pattern */
@@ -989,9 +1303,7 @@ scanpast(char c)
 	setmark(c);
 	cp = blockp;
 	do {	/* innermost loop optimized to only one test */
-		while (*cp != c) {
-			++cp;
-		}
+		cp = findmark(cp);
 	} while (*(cp + 1) == '\0' && (cp = read_block()) != NULL);
 	blockp = cp;
 	if (cp != NULL) {
@@ -1005,8 +1317,24 @@ scanpast(char c)
 char *
 read_block(void)
 {
-	/* read the next block */
-	blocklen = read(symrefs, block, BUFSIZ);
+	long	offset;
+
+	/* read the next block, unpacking it if the cross-reference is
+	   block-compressed, or copy it from the mapped cross-reference */
+	if (blocktable > 0) {
+		blocklen = readpacked(symrefs, dbmap, dbmapsize,
+				      blocknumber + 1, block);
+	} else if (dbmap != NULL) {
+		offset = (blocknumber + 1) * BUFSIZ;
+		blocklen = 0;
+		if (offset < dbmapsize) {
+			blocklen = dbmapsize - offset < BUFSIZ ?
+				dbmapsize - offset : BUFSIZ;
+			memcpy(block, dbmap + offset, blocklen);
+		}
+	} else {
+		blocklen = read(symrefs, block, BUFSIZ);
+	}
 	blockp = block;
 	
 	/* add the search character and end-of-block mark */
@@ -1080,6 +1408,7 @@ findcalledby(char *pattern)
 				return(&found_caller);
 			}
 			progress("Search", searchcount, nsrcfiles);
+			(void) skipfile(file);
 			break;
 
 		case DEFINE:		/* could be a macro */
@@ -1111,6 +1440,8 @@ findterm(char *pattern)
 	int	len;
 	char	prefix[PATLEN + 1];
 	char	term[PATLEN + 1];
+	char	**terms;
+	int	i;
 
 	npostings = 0;		/* will be non-zero after database built */
 	lastfcnoffset = 0;	/* clear the last function name found */
@@ -1121,6 +1452,31 @@ findterm(char *pattern)
 	if ((s = strpbrk(prefix, ".[{*+")) != NULL) {
 		*s = '\0';
 	}
+	/* without a prefix every term would be matched, so if the trigram
+	   index has the terms with the string every match contains, match
+	   just those */
+	if (*prefix == '\0' &&
+	    (terms = trigramterms(must, strlen(must))) != NULL) {
+		for (i = 0; terms[i] != NULL; ++i) {
+			(void) invfind(&invcontrol, terms[i]);
+			(void) invterm(&invcontrol, term);
+			s = term;
+			if (caseless == YES) {
+				s = lcasify(s);	/* make it lower case */
+			}
+			if (strcmp(term, terms[i]) == 0 && regexpmatch(s) == YES &&
+			    (postingp = boolfile(&invcontrol, &npostings, BOOL_OR)) == NULL) {
+				break;
+			}
+			if (++searchcount % 50 == 0) {
+				progress("Symbols matched", searchcount, totalterms);
+			}
+		}
+		free(terms);
+		searchcount = 0;
+		postingsfound = npostings;
+		return;
+	}
 	/* if letter case is to be ignored */
 	if (caseless == YES) {
 		
@@ -1150,7 +1506,7 @@ findterm(char *pattern)
 			s = lcasify(s);	/* make it lower case */
 		}
 		/* if it matches */
-		if (regexec (&regexp, s, (size_t)0, NULL, 0) == 0) {
+		if (regexpmatch(s) == YES) {
 	
 			/* add its postings to the set */
 			if ((postingp = boolfile(&invcontrol, &npostings, BOOL_OR)) == NULL) {
@@ -1183,20 +1539,205 @@ findterm(char *pattern)
 	postingsfound = npostings;
 }
 
+/* run a linear search of the cross-reference in parallel jobs, each
+   searching the files of a part of it, and append their references to
+   the output in file order, so they are the same as from one search.
+   Returns NO if the search is to be run here instead */
+
+BOOL
+searchjobs(char *(*findfcn)(char *))
+{
+	long	size;		/* bytes of files to search */
+	long	tasksize;	/* bytes per task */
+	long	i;
+	int	ntasks;
+	int	task;
+	BOOL	ok;
+
+	/* the jobs find their files through the segments, and copy blocks
+	   from the mapped cross-reference rather than share its offset */
+	if (njobs < 2 || jobworker == YES || dbmap == NULL
+	    || (invertedindex == YES && findfcn != findassign)
+	    || (findfcn != findsymbol && findfcn != findassign
+		&& findfcn != finddef && findfcn != findcalling
+		&& findfcn != findinclude)
+	    || readsegments() == NO || nsegments < 2) {
+		return(NO);
+	}
+	/* split the files to search into parts of about the same size */
+	size = 0;
+	for (i = 0; i < nsegments; ++i) {
+		if (wanted == NULL || wanted[segments[i].fileindex] == YES) {
+			size += (i + 1 < nsegments ? segments[i + 1].offset :
+				 segmentsend) - segments[i].offset;
+		}
+	}
+	tasksize = size / (njobs * SEARCHTASKS) + 1;
+	tasksegment = mymalloc((njobs * SEARCHTASKS + 2) * sizeof(*tasksegment));
+	ntasks = 0;
+	size = tasksize;
+	for (i = 0; i < nsegments; ++i) {
+		if (size >= tasksize) {
+			tasksegment[ntasks++] = i;
+			size = 0;
+		}
+		if (wanted == NULL || wanted[segments[i].fileindex] == YES) {
+			size += (i + 1 < nsegments ? segments[i + 1].offset :
+				 segmentsend) - segments[i].offset;
+		}
+	}
+	tasksegment[ntasks] = nsegments;
+	if (wanted == NULL) {
+		wanted = mymalloc(nsrcfiles + 1);
+		memset(wanted, YES, nsrcfiles);
+	}
+
+	taskfcn = findfcn;
+	ok = runjobs(ntasks, searchtask, NULL);
+	for (task = 0; ok == YES && task < ntasks; ++task) {
+		appendjobfile(task, ".r", refsfound);
+		appendjobfile(task, ".n", nonglobalrefs);
+	}
+	removejobfiles();
+	free(tasksegment);
+	tasksegment = NULL;
+	return(ok);
+}
+
+/* search job task: search the files of a part of the cross-reference,
+   writing the global and non-global references to the task's files */
+
+static BOOL
+searchtask(int task, void *arg)
+{
+	static	char	*selected;	/* files wanted by the parent */
+	long	i;
+
+	(void) arg;
+	/* an interrupt stops the search in the parent, so just stop */
+	signal(SIGINT, SIG_DFL);
+	if ((refsfound = myfopen(jobfile(task, ".r"), "wb")) == NULL
+	    || (nonglobalrefs = myfopen(jobfile(task, ".n"), "wb")) == NULL) {
+		return(NO);
+	}
+	/* search only the wanted files of this part; a worker can run
+	   several tasks, so keep the files wanted by the parent */
+	if (selected == NULL) {
+		selected = wanted;
+		wanted = mymalloc(nsrcfiles + 1);
+	}
+	memset(wanted, NO, nsrcfiles);
+	for (i = tasksegment[task]; i < tasksegment[task + 1]; ++i) {
+		wanted[segments[i].fileindex] = selected[segments[i].fileindex];
+	}
+	cursegment = 0;
+	(void) dbseek(0L);
+	(void) (*taskfcn)(Pattern);
+	return(fclose(refsfound) != EOF && fclose(nonglobalrefs) != EOF);
+}
+
+/* append a search job task's references file to the output */
+
+static void
+appendjobfile(int task, char *suffix, FILE *output)
+{
+	FILE	*refs;
+	char	buf[BUFSIZ];
+	size_t	n;
+
+	if ((refs = myfopen(jobfile(task, suffix), "rb")) != NULL) {
+		while ((n = fread(buf, 1, sizeof(buf), refs)) > 0) {
+			(void) fwrite(buf, 1, n, output);
+		}
+		fclose(refs);
+	}
+}
+
 /* get the next posting for this term */
 
 static POSTING *
 getposting(void)
 {
-	if (npostings-- <= 0) {
-		return(NULL);
+	POSTING	*p;
+
+	do {
+		if (npostings-- <= 0) {
+			return(NULL);
+		}
+		/* display progress about every three seconds */
+		if (++searchcount % 100 == 0) {
+			progress("Possible references retrieved", searchcount,
+			    postingsfound);
+		}
+		p = postingp++;
+	} while (wanted != NULL && wanted[p->fileindex] == NO);
+	return(p);
+}
+
+/* see if the search is limited to files not including this one */
+
+static BOOL
+filewanted(char *file)
+{
+	if (subset != NULL
+	    && regexec(&subsetexp, file, (size_t)0, NULL, 0) != 0) {
+		return(NO);
 	}
-	/* display progress about every three seconds */
-	if (++searchcount % 100 == 0) {
-		progress("Possible references retrieved", searchcount,
-		    postingsfound);
+	if (field == OUTLINE) {
+		if (caseless == YES) {
+			file = lcasify(file);
+		}
+		return(regexpmatch(file));
 	}
-	return(postingp++);
+	return(YES);
+}
+
+/* if the search is limited to other files than the one whose name was
+   just read, move to the newline before the next file to search and
+   return YES.  The file segments in the trailer give its offset, or
+   without them the data is scanned for it */
+
+static BOOL
+skipfile(char *file)
+{
+	long	offset;
+
+	if (wanted == NULL) {
+		return(NO);
+	}
+	offset = blocknumber * BUFSIZ + (blockp - block);
+	if (segments != NULL) {
+		while (cursegment < nsegments
+		       && segments[cursegment].offset < offset) {
+			++cursegment;
+		}
+		if (cursegment > 0
+		    && wanted[segments[cursegment - 1].fileindex] == YES) {
+			return(NO);
+		}
+		while (cursegment < nsegments
+		       && wanted[segments[cursegment].fileindex] == NO) {
+			++cursegment;
+		}
+		if (cursegment < nsegments) {
+			offset = segments[cursegment].offset;
+		} else {
+			offset = segmentsend;
+		}
+	} else {
+		if (filewanted(file) == YES) {
+			return(NO);
+		}
+		while (scanpast('\t') != NULL && *blockp != NEWFILE) {
+			;
+		}
+		if (blockp == NULL) {
+			return(YES);
+		}
+		offset = blocknumber * BUFSIZ + (blockp - block) + 1;
+	}
+	(void) dbseek(offset - 3);	/* the newline before its tab */
+	return(YES);
 }
 
 /* put the posting reference into the file */
@@ -1242,7 +1783,9 @@ dbseek(long offset)
 	int	rc = 0;
 	
 	if ((n = offset / BUFSIZ) != blocknumber) {
-		if ((rc = lseek(symrefs, n * BUFSIZ, 0)) == -1) {
+		if (blocktable > 0 || dbmap != NULL) {
+			blocknumber = n - 1;	/* read_block() reads block n */
+		} else if ((rc = lseek(symrefs, n * BUFSIZ, 0)) == -1) {
 			myperror("Lseek failed");
 			(void) sleep(3);
 			return(rc);
@@ -1254,6 +1797,39 @@ dbseek(long offset)
 	return(rc);
 }
 
+/* map the open cross-reference file, so read_block() copies each block
+   from memory and dbseek() does not seek.  The blocks are still copied
+   because the searches put their mark character after the block */
+
+void
+mapdatabase(void)
+{
+	struct	stat	statstruct;
+
+	unmapdatabase();
+	if (fstat(symrefs, &statstruct) == 0 && statstruct.st_size > 0) {
+		dbmap = mmap(NULL, statstruct.st_size, PROT_READ, MAP_SHARED,
+			     symrefs, 0);
+		if (dbmap == MAP_FAILED) {	/* read it instead */
+			dbmap = NULL;
+		} else {
+			dbmapsize = statstruct.st_size;
+		}
+	}
+}
+
+/* unmap the cross-reference file before it is closed */
+
+void
+unmapdatabase(void)
+{
+	if (dbmap != NULL) {
+		munmap(dbmap, dbmapsize);
+		dbmap = NULL;
+		dbmapsize = 0;
+	}
+}
+
 static void
 findcalledbysub(char *file, BOOL macro)
 {
@@ -203,6 +203,14 @@ typedef	struct {		/* mouse action */
 	int	y2;
 } MOUSE;
 
+typedef	struct {		/* open-addressed file name hash table */
+	char	**names;	/* the names, or NULL for an empty slot */
+	unsigned long size;	/* number of slots, a power of 2 */
+	unsigned long count;	/* number of names */
+	unsigned long lookups;	/* name lookups */
+	unsigned long probes;	/* slots compared in them */
+} NAMETABLE;
+
 struct cmd {			/* command history struct */
 	struct	cmd *prev, *next;	/* list ptrs */
 	int	field;			/* input field number */
@@ -247,12 +255,14 @@ extern	BOOL	kernelmode;	/* don't use DFLT_INCDIR - bad for kernels */
 extern	BOOL	linemode;	/* use line oriented user interface */
 extern	BOOL	verbosemode;	/* print extra information on line mode */
 extern	BOOL	recurse_dir;	/* recurse dirs when searching for src files */
+extern	BOOL	remove_symfile_onexit; /* remove the database on exit */
 extern	char	*namefile;	/* file of file names */
 extern	BOOL	ogs;		/* display OGS book and subsystem names */
 extern	char	*prependpath;	/* prepend path to file names */
 extern	FILE	*refsfound;	/* references found file */
 extern	char	temp1[];	/* temporary file name */
 extern	char	temp2[];	/* temporary file name */
+extern	char	tempdirpv[];	/* private temp directory */
 extern	long	totalterms;	/* total inverted index terms */
 extern	BOOL	trun_syms;	/* truncate symbols to 8 characters */
 extern	char	tempstring[TEMPSTRING_LEN + 1]; /* global dummy string buffer */
@@ -309,6 +319,7 @@ extern	char	blockmark;	/* mark character to be searched for */
 extern	long	blocknumber;	/* block number */
 extern	char	*blockp;	/* pointer to current character in block */
 extern	int	blocklen;	/* length of disk block read */
+extern	char	*subset;	/* --subset file name pattern, or NULL */
 
 /* lookup.c global data */
 extern	struct	keystruct {
@@ -328,11 +339,14 @@ extern	BOOL	unixpcmouse;		/* UNIX PC mouse interface */
 
 char	*filepath(char *file);
 char	*findcalledby(char *pattern);
+char	**findname(NAMETABLE *table, char *name);
 char	*findcalling(char *pattern);
 char	*findallfcns(char *dummy);
 char	*finddef(char *pattern);
 char	*findfile(char *dummy);
 char	*findinclude(char *pattern);
+char	*findoutline(char *pattern);
+char	*findrefs(FINDINIT *rc, BOOL *funcexist);
 char	*findsymbol(char *pattern);
 char	*findassign(char *pattern);
 char	*findregexp(char *egreppat);
@@ -369,11 +383,15 @@ void    freesrclist(void);
 void    freeinclist(void);
 void    freecrossref(void);
 void	freefilelist(void);
+void	freenames(NAMETABLE *table, BOOL strings);
+void	freeincludes(void);
 void	help(void);
 void	incfile(char *file, char *type);
+void	initsubset(void);
 void    includedir(char *_dirname);
 void    initsymtab(void);
 void	makefilelist(void);
+void	mapdatabase(void);
 void	mousecleanup(void);
 void	mousemenu(void);
 void	mouseinit(void);
@@ -389,11 +407,15 @@ void	posterr(char *msg,...);
 void	postfatal(const char *msg,...);
 void	putposting(char *term, int type);
 void	fetch_string_from_dbase(char *, size_t);
+void	readcrossref(void);
 void	resetcmd(void);
 void	seekline(unsigned int line);
 void	setfield(void);
+void	skipsrcfile(char *path);
 void	shellpath(char *out, int limit, char *in);
 void    sourcedir(char *dirlist);
+void	srcnamestats(void);
+void	unmapdatabase(void);
 void	myungetch(int c);
 void	warning(char *text);
 void	writestring(char *s);
@@ -402,6 +424,8 @@ BOOL	command(int commandc);
 BOOL	infilelist(char *file);
 BOOL	readrefs(char *filename);
 BOOL	search(void);
+BOOL	searchjobs(char *(*findfcn)(char *));
+BOOL	setsubset(char *pattern);
 BOOL	writerefsfound(void);
 
 FINDINIT findinit(char *pattern);
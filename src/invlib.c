@@ -48,7 +48,6 @@
 #define	DEBUG		0	/* debugging code and realloc messages */
 #define BLOCKSIZE	2 * BUFSIZ	/* logical block size */
 #define	POSTINC		10000	/* posting buffer size increment */
-#define SEP		' '	/* sorted posting field separator */
 #define	SETINC		100	/* posting set size increment */
 #define	STATS		0	/* print statistics */
 #define	SUPERINC	10000	/* super index size increment */
@@ -65,9 +64,16 @@ static char const rcsid[] = "$Id: invlib.c,v 1.22 2014/11/20 21:12:54 broeker Ex
 int	invbreak;
 #endif
 
+static	int	boolmerge(POSTING *postings, long num);
 static	int	boolready(void);
+static	int	compareposting(const void *p1, const void *p2);
+static	long	indexfind(INVCONTROL *invcntl, char *searchterm);
+static	int	indexforward(INVCONTROL *invcntl);
+static	long	indexterm(INVCONTROL *invcntl, char *term);
 static	int	invnewterm(void);
+static	int	invside(INVCONTROL *invcntl);
 static	void	invstep(INVCONTROL *invcntl);
+static	POSTING	*readpostings(INVCONTROL *invcntl, long *num);
 static	void	invcannotalloc(unsigned n);
 static	void	invcannotopen(char *file);
 static	void	invcannotwrite(char *file);
@@ -77,6 +83,8 @@ int	showzipf;	/* show postings per term distribution */
 #endif
 
 static	POSTING	*item, *enditem, *item1 = NULL, *item2 = NULL;
+static	POSTING	*postbuf;	/* postings of the present term */
+static	long	postbufsize;
 static	unsigned int setsize1, setsize2;
 static	long	numitems, totterm, zerolong;
 static	char	*indexfile, *postingfile;
@@ -85,6 +93,7 @@ static	size_t supersize = SUPERINC, supintsize;
 static  unsigned int numpost, numlogblk, amtused, nextpost;
 static  unsigned int lastinblk, numinvitems;
 static	POSTING	*POST, *postptr;
+static	long	spilled;	/* bytes of this term's postings already written */
 static	unsigned long	*SUPINT, *supint, nextsupfing;
 static	char	*SUPFING, *supfing;
 static	char	thisterm[TERMMAX];
@@ -94,24 +103,28 @@ typedef union logicalblk {
 } t_logicalblk;
 static t_logicalblk logicalblk;
 
-#if DEBUG || STATS
 static	long	totpost;
-#endif
+
+/* totals of the last inverted index made */
+long	invpostings;	/* postings */
+long	invterms;	/* terms */
+long	invblocks;	/* logical blocks */
+long	invbytes;	/* size of the index and postings files */
+long	invpostmemory;	/* posting buffer limit in bytes, or 0 for none */
 
 #if STATS
 static	int	zipf[ZIPFSIZE + 1];
 #endif
 
 long
-invmake(char *invname, char *invpost, FILE *infile)
+invmake(char *invname, char *invpost, char *(*readposting)(TEMPPOSTING *p))
 {
-	unsigned char	*s;
-	long	num;
 	int	i;
-	long	fileindex = 0;	/* initialze, to avoid warning */
 	unsigned postsize = POSTINC * sizeof(*POST);
 	unsigned long	*intptr;
-	char	line[TERMMAX];
+	char	*term;
+	char	*lastterm = NULL;	/* term of the previous posting */
+	TEMPPOSTING tp;
 	long	tlong;
 	PARAM	param;
 	POSTING	posting;
@@ -135,6 +148,7 @@ invmake(char *invname, char *invpost, FILE *infile)
 	}
 	postingfile = invpost;
 	nextpost = 0;
+	spilled = 0;
 	/* get space for the postings list */
 	if ((POST = malloc(postsize)) == NULL) {
 		invcannotalloc(postsize);
@@ -162,9 +176,7 @@ invmake(char *invname, char *invpost, FILE *infile)
 	*supfing++ = ' ';
 	*supfing++ = '\0';
 	nextsupfing = 2;
-#if DEBUG || STATS
 	totpost = 0L;
-#endif
 	totterm = 0L;
 	numpost = 1;
 
@@ -175,40 +187,49 @@ invmake(char *invname, char *invpost, FILE *infile)
 	numlogblk = 0;
 	lastinblk = sizeof(t_logicalblk);
 
-	/* now loop as long as more to read (till eof)  */
-	while (fgets(line, TERMMAX, infile) != NULL) {
-#if DEBUG || STATS
+	/* now loop as long as more postings */
+	while ((term = (*readposting)(&tp)) != NULL) {
 		++totpost;
-#endif
-		s = strchr(line, SEP);
-		if (s != NULL) {
-			*s = '\0';
-		}
-		else {
+		if (strlen(term) >= TERMMAX) {
 			continue;
 		}
 #if STATS
-		if ((i = strlen(line)) > maxtermlen) {
+		if ((i = strlen(term)) > maxtermlen) {
 			maxtermlen = i;
 		}
 #endif
 #if DEBUG
-		printf("%ld: %s ", totpost, line);
+		printf("%ld: %s ", totpost, term);
 		fflush(stdout);
 #endif
-		if (strcmp(thisterm, line) == 0) {
+		/* the same term is always the same string */
+		if (term == lastterm) {
 			if ((postptr + 10) > (POST + (postsize / sizeof(*POST)))) {
 				i = postptr - POST;
-				postsize += POSTINC * sizeof(*POST);
-				if ((POST = realloc(POST, postsize)) == NULL) {
-					invcannotalloc(postsize);
-					return(0);
-				}
-				postptr = i + POST;
+				/* write out the postings of a very frequent
+				   term rather than grow past the limit */
+				if (invpostmemory > 0
+				    && postsize + POSTINC * sizeof(*POST)
+				       > (unsigned long) invpostmemory) {
+					if (fwrite(POST, sizeof(*POST), i,
+						   fpost) != (size_t) i) {
+						invcannotwrite(postingfile);
+						return(0);
+					}
+					spilled += i * sizeof(*POST);
+					postptr = POST;
+				} else {
+					postsize += POSTINC * sizeof(*POST);
+					if ((POST = realloc(POST, postsize)) == NULL) {
+						invcannotalloc(postsize);
+						return(0);
+					}
+					postptr = i + POST;
 #if DEBUG
-				printf("reallocated post space to %u, totpost=%ld\n",
-				       postsize, totpost);
+					printf("reallocated post space to %u, totpost=%ld\n",
+					       postsize, totpost);
 #endif
+				}
 			}
 			numpost++;
 		} else {
@@ -216,33 +237,18 @@ invmake(char *invname, char *invpost, FILE *infile)
 			if (!invnewterm()) {
 				return(0);
 			}
-			strcpy(thisterm, line);
+			strcpy(thisterm, term);
+			lastterm = term;
 			numpost = 1;
 			postptr = POST;
-			fileindex = 0;
-		}
-		/* get the new posting */
-		num = *++s - '!';
-		i = 1;
-		do {
-			num = BASE * num + *++s - '!';
-		} while (++i < PRECISION);
-		posting.lineoffset = num;
-		while (++fileindex < nsrcfiles && num > srcoffset[fileindex]) {
-			;
 		}
-		posting.fileindex = --fileindex;
-		posting.type = *++s;
-		++s;
-		if (*s != '\n') {
-			num = *++s - '!';
-			while (*++s != '\n') {
-				num = BASE * num + *s - '!';
-			}
-			posting.fcnoffset = num;
-		}
-		else {
-			posting.fcnoffset = 0;
+		/* get the new posting, whose offsets are from its file name */
+		posting.lineoffset = srcoffset[tp.fileindex] + tp.lineoffset;
+		posting.fileindex = tp.fileindex;
+		posting.type = tp.type;
+		posting.fcnoffset = 0;
+		if (tp.fcnoffset != 0) {
+			posting.fcnoffset = srcoffset[tp.fileindex] + tp.fcnoffset;
 		}
 		*postptr++ = posting;
 #if DEBUG
@@ -290,6 +296,7 @@ invmake(char *invname, char *invpost, FILE *infile)
 	    fflush(outfile) == EOF) {	/* rewind doesn't check for write failure */
 		goto cannotwrite;
 	}
+	invbytes = ftell(outfile) + ftell(fpost);
 	/* write the control area */
 	rewind(outfile);
 	param.version = FMTVERSION;
@@ -325,6 +332,9 @@ invmake(char *invname, char *invpost, FILE *infile)
 		return(0);
 	}
 	--totterm;	/* don't count null term */
+	invpostings = totpost;
+	invterms = totterm;
+	invblocks = numlogblk;
 #if STATS
 	printf("logical blocks = %d, postings = %ld, terms = %ld, max term length = %d\n",
 	    numlogblk, totpost, totterm, maxtermlen);
@@ -504,6 +514,8 @@ invnewterm(void)
 	}
 	nextpost += i * sizeof(*POST);
     }
+    nextpost += spilled;
+    spilled = 0;
     logicalblk.invblk[3+2*numinvitems++] = iteminfo.packword[0];
     logicalblk.invblk[2+2*numinvitems] = iteminfo.packword[1];
     return(1);
@@ -577,6 +589,11 @@ invopen(INVCONTROL *invcntl, char *invname, char *invpost, int stat)
 {
 	int	read_index;
 
+	invcntl->delta = NULL;
+	invcntl->filemap = NULL;
+	invcntl->fileshift = NULL;
+	invcntl->nfilemap = 0;
+	invcntl->ended = 0;
 	invcntl->invfile = open_file_with_possibly_flipped_name(invname, INVNAME, INVNAME2, stat);
 	if (! invcntl->invfile) {
 		invcannotopen(invname);
@@ -703,6 +720,42 @@ invclose(INVCONTROL *invcntl)
 	if (invcntl->iindex != NULL)
 		free(invcntl->iindex);
 	free(invcntl->logblk);
+	if (invcntl->delta != NULL) {
+		invclose(invcntl->delta);
+		free(invcntl->delta);
+		invcntl->delta = NULL;
+	}
+	if (invcntl->filemap != NULL) {
+		free(invcntl->filemap);
+		free(invcntl->fileshift);
+		invcntl->filemap = NULL;
+		invcntl->fileshift = NULL;
+	}
+}
+
+/** invdelta adds the index of the files changed since the inverted
+    file was made, if any, and the maps that move the inverted file's
+    postings to their files' present place in the database.  Postings
+    of files mapped to -1 have been replaced by the delta index **/
+int
+invdelta(INVCONTROL *invcntl, char *invname, char *invpost,
+	 long *filemap, long *fileshift, long nfilemap)
+{
+	invcntl->filemap = filemap;
+	invcntl->fileshift = fileshift;
+	invcntl->nfilemap = nfilemap;
+	if (invname == NULL)
+		return(1);
+	if ((invcntl->delta = malloc(sizeof(*invcntl->delta))) == NULL) {
+		invcannotalloc(sizeof(*invcntl->delta));
+		return(-1);
+	}
+	if (invopen(invcntl->delta, invname, invpost, INVAVAIL) == -1) {
+		free(invcntl->delta);
+		invcntl->delta = NULL;
+		return(-1);
+	}
+	return(1);
 }
 
 /** invstep steps the inverted file forward one item **/
@@ -726,9 +779,45 @@ invstep(INVCONTROL *invcntl)
 	invcntl->keypnt = 0; 
 }
 
-/** invforward moves forward one term in the inverted file  **/
+/** invside compares the present terms of an inverted file and its
+    delta index, treating one that has wrapped around as the greater **/
+static int
+invside(INVCONTROL *invcntl)
+{
+	char	term1[TERMMAX], term2[TERMMAX];
+
+	if (invcntl->delta->ended)
+		return(-1);
+	if (invcntl->ended)
+		return(1);
+	indexterm(invcntl, term1);
+	indexterm(invcntl->delta, term2);
+	return(strcmp(term1, term2));
+}
+
+/** invforward moves forward one term in the inverted file and its
+    delta index, returning 0 once both have wrapped around **/
 int
 invforward(INVCONTROL *invcntl)
+{
+	INVCONTROL *delta = invcntl->delta;
+	int	i;
+
+	if (delta == NULL)
+		return(indexforward(invcntl));
+
+	/* step whichever of the two is at the present term */
+	i = invside(invcntl);
+	if (i <= 0 && !invcntl->ended && indexforward(invcntl) == 0)
+		invcntl->ended = 1;
+	if (i >= 0 && !delta->ended && indexforward(delta) == 0)
+		delta->ended = 1;
+	return(!invcntl->ended || !delta->ended);
+}
+
+/** indexforward moves forward one term in a single inverted file **/
+static int
+indexforward(INVCONTROL *invcntl)
 {
 	invstep(invcntl); 
 	/* skip things with 0 postings */
@@ -742,9 +831,27 @@ invforward(INVCONTROL *invcntl)
 	return(1);
 }
 
-/**  invterm gets the present term from the present logical block  **/
+/**  invterm gets the present term of the inverted file and its delta
+     index, and the number of postings the two have for it **/
 long
 invterm(INVCONTROL *invcntl, char *term)
+{
+	long	num = 0;
+	int	i;
+
+	if (invcntl->delta == NULL)
+		return(indexterm(invcntl, term));
+	i = invside(invcntl);
+	if (i <= 0)
+		num = indexterm(invcntl, term);
+	if (i >= 0)
+		num += indexterm(invcntl->delta, term);
+	return(num);
+}
+
+/**  indexterm gets the present term from the present logical block  **/
+static long
+indexterm(INVCONTROL *invcntl, char *term)
 {
 	ENTRY * entryptr;
 
@@ -756,9 +863,30 @@ invterm(INVCONTROL *invcntl, char *term)
 	return(entryptr->post);
 }
 
-/** invfind searches for an individual item in the inverted file  **/
+/* a search past the last term wraps around to the null first term */
+#define	WRAPPED(invcntl, searchterm)	(*(searchterm) != '\0' && \
+	(invcntl)->numblk == 0 && (invcntl)->keypnt == 0)
+
+/** invfind searches for an individual item in the inverted file and
+    its delta index **/
 long
 invfind(INVCONTROL *invcntl, char *searchterm) /* term being searched for  */
+{
+	INVCONTROL *delta = invcntl->delta;
+	long	num;
+
+	num = indexfind(invcntl, searchterm);
+	if (delta != NULL && num >= 0) {
+		invcntl->ended = WRAPPED(invcntl, searchterm);
+		num += indexfind(delta, searchterm);
+		delta->ended = WRAPPED(delta, searchterm);
+	}
+	return(num);
+}
+
+/** indexfind searches for an individual item in a single inverted file **/
+static long
+indexfind(INVCONTROL *invcntl, char *searchterm)
 {
 	int	imid, ilow, ihigh;
 	long	num;
@@ -935,7 +1063,26 @@ boolfile(INVCONTROL *invcntl, long *num, int boolarg)
 	unsigned u;
 	POSTING *newsetp = NULL, *set1p;
 	long	newsetc, set1c, set2c;
+	long	n;
+	int	i;
 
+	/* merge a delta index's postings, and move the inverted file's
+	   postings to where their files now are in the database */
+	if (invcntl->delta != NULL || invcntl->filemap != NULL) {
+		i = (invcntl->delta != NULL) ? invside(invcntl) : -1;
+		if (i <= 0 && ((newsetp = readpostings(invcntl, &n)) == NULL ||
+		    boolmerge(newsetp, n) == -1)) {
+			*num = -1;
+			return(NULL);
+		}
+		if (i >= 0 && ((newsetp = readpostings(invcntl->delta, &n)) == NULL ||
+		    boolmerge(newsetp, n) == -1)) {
+			*num = -1;
+			return(NULL);
+		}
+		*num = numitems;
+		return(item);
+	}
 	/* FIXME HBB: magic number alert! (3) */
 	entryptr = (ENTRY *) (invcntl->logblk->invblk + 3) + invcntl->keypnt;
 	ptr = invcntl->logblk->chrblk + entryptr->offset;
@@ -1148,6 +1295,134 @@ boolfile(INVCONTROL *invcntl, long *num, int boolarg)
 	return((POSTING *) item);
 }
 
+/** readpostings reads the present term's postings, moving them to
+    their files' present database offsets and dropping those of files
+    replaced by a delta index **/
+static POSTING *
+readpostings(INVCONTROL *invcntl, long *num)
+{
+	ENTRY	*entryptr;
+	void	*ptr;
+	unsigned long	*ptr2;
+	POSTING	*p, *q, *endp;
+	long	fileindex, n;
+	int	sorted = 1;
+
+	/* FIXME HBB: magic number alert! (3) */
+	entryptr = (ENTRY *) (invcntl->logblk->invblk + 3) + invcntl->keypnt;
+	ptr = invcntl->logblk->chrblk + entryptr->offset;
+	ptr2 = ((unsigned long *) ptr) + (entryptr->size + (sizeof(long) - 1)) / sizeof(long);
+	n = entryptr->post;
+	if (n > postbufsize) {
+		postbufsize = n + SETINC;
+		if ((postbuf = realloc(postbuf, postbufsize * sizeof(*postbuf))) == NULL) {
+			invcannotalloc(postbufsize * sizeof(*postbuf));
+			postbufsize = 0;
+			return(NULL);
+		}
+	}
+	fseek(invcntl->postfile, *ptr2, SEEK_SET);
+	n = fread(postbuf, sizeof(*postbuf), n, invcntl->postfile);
+	if (invcntl->filemap != NULL) {
+		endp = postbuf + n;
+		for (p = q = postbuf; p < endp; ++p) {
+			fileindex = p->fileindex;
+			if (fileindex >= invcntl->nfilemap ||
+			    invcntl->filemap[fileindex] < 0) {
+				continue;
+			}
+			*q = *p;
+			q->lineoffset += invcntl->fileshift[fileindex];
+			if (q->fcnoffset != 0)
+				q->fcnoffset += invcntl->fileshift[fileindex];
+			q->fileindex = invcntl->filemap[fileindex];
+
+			/* files may have moved past each other */
+			if (q > postbuf && compareposting(q - 1, q) > 0)
+				sorted = 0;
+			++q;
+		}
+		n = q - postbuf;
+		if (!sorted)
+			qsort(postbuf, n, sizeof(*postbuf), compareposting);
+	}
+	*num = n;
+	return(postbuf);
+}
+
+/** compareposting orders postings the way the posting set is **/
+static int
+compareposting(const void *p1, const void *p2)
+{
+	const POSTING *a = p1, *b = p2;
+
+	if (a->lineoffset != b->lineoffset)
+		return(a->lineoffset < b->lineoffset ? -1 : 1);
+	if (a->type != b->type)
+		return(a->type < b->type ? -1 : 1);
+	return(0);
+}
+
+/** boolmerge ORs sorted postings into the posting set **/
+static int
+boolmerge(POSTING *postings, long num)
+{
+	POSTING	*newitem, *newsetp, *set1p;
+	POSTING	*endp = postings + num;
+	unsigned u;
+	int	i;
+
+	u = numitems + num;
+	if (item == item2) {
+		if (u > setsize1) {
+			u += SETINC;
+			if ((item1 = realloc(item1, u * sizeof(*item1))) == NULL) {
+				invcannotalloc(u * sizeof(*item1));
+				boolready();
+				return(-1);
+			}
+			setsize1 = u;
+		}
+		newitem = item1;
+	}
+	else {
+		if (u > setsize2) {
+			u += SETINC;
+			if ((item2 = realloc(item2, u * sizeof(*item2))) == NULL) {
+				invcannotalloc(u * sizeof(*item2));
+				boolready();
+				return(-1);
+			}
+			setsize2 = u;
+		}
+		newitem = item2;
+	}
+	set1p = item;
+	newsetp = newitem;
+	while (set1p < enditem && postings < endp) {
+		if ((i = compareposting(set1p, postings)) < 0) {
+			*newsetp++ = *set1p++;
+		}
+		else if (i > 0) {
+			*newsetp++ = *postings++;
+		}
+		else {	/* identical postings */
+			*newsetp++ = *set1p++;
+			postings++;
+		}
+	}
+	while (set1p < enditem) {
+		*newsetp++ = *set1p++;
+	}
+	while (postings < endp) {
+		*newsetp++ = *postings++;
+	}
+	item = newitem;
+	enditem = newsetp;
+	numitems = newsetp - newitem;
+	return(0);
+}
+
 #if 0
 POSTING *
 boolsave(int clear)		/* flag about whether to clear core  */
@@ -37,22 +37,20 @@
 #define CSCOPE_INVLIB_H
 
 #include <stdio.h>		/* need definition of FILE* */
-#include <limits.h>             /* need definition of CHAR_MAX */
 
 /* inverted index definitions */
 
-/* postings temporary file long number coding into characters */
-#if CHAR_MAX==255
-# define	BASE		223	/* 255 - ' ' */
-# define	PRECISION	4	/* maximum digits after converting a long */
-#else
-# if CHAR_MAX==127	/* assume sign-extension of a char when converted to an int */
-#  define	BASE		95	/* 127 - ' ' */
-#  define	PRECISION	5	/* maximum digits after converting a long */
-# else
-  #error Need a platform with 8 bits in a char value
-# endif
-#endif
+/* postings temporary file record, sorted by term name and then by
+   offset before the inverted index is made from it */
+typedef	struct {
+	unsigned int	term;		/* term number */
+	unsigned int	fileindex : 24;	/* source file name offset index */
+	unsigned int	type : 8;	/* reference type (mark character) */
+	unsigned int	lineoffset;	/* source line offset from the file name */
+	unsigned int	fcnoffset;	/* function name offset from the file name, or 0 */
+} TEMPPOSTING;
+
+#define	MAXPOSTFILES	(1L << 24)	/* files a posting's file index can number */
 
 /* inverted index access parameters */
 #define INVAVAIL	0
@@ -76,7 +74,7 @@ typedef	struct	{
 	long	share;		/* flag whether to use shared memory */
 } PARAM;
 
-typedef	struct {
+typedef	struct invcontrol {
 	FILE	*invfile;	/* the inverted file ptr */
 	FILE	*postfile;	/* posting file ptr */
 	PARAM	param;		/* control parameters for the file */
@@ -84,6 +82,11 @@ typedef	struct {
 	union logicalblk *logblk;	/* ptr to space for a logical block */
 	long	numblk;		/* number of block presently at *logblk */
 	long	keypnt;		/* number item in present block found */
+	struct invcontrol *delta;	/* index of files changed since, or NULL */
+	long	*filemap;	/* present file index of each indexed file, or -1 */
+	long	*fileshift;	/* database offset change of each indexed file */
+	long	nfilemap;	/* number of indexed files mapped */
+	int	ended;		/* term search has wrapped around */
 } INVCONTROL;
 
 typedef        struct  {
@@ -103,15 +106,23 @@ typedef	struct {
 extern	long	*srcoffset;	/* source file name database offsets */
 extern	int	nsrcoffset;	/* number of file name database offsets */
 
+extern	long	invpostings;	/* postings in the last inverted index made */
+extern	long	invterms;	/* terms in it */
+extern	long	invblocks;	/* logical blocks in it */
+extern	long	invbytes;	/* size of its index and postings files */
+extern	long	invpostmemory;	/* posting buffer limit in bytes, or 0 */
+
 
 void	boolclear(void);
 POSTING	*boolfile(INVCONTROL *invcntl, long *num, int boolarg);
 void	invclose(INVCONTROL *invcntl);
+int	invdelta(INVCONTROL *invcntl, char *invname, char *invpost,
+		 long *filemap, long *fileshift, long nfilemap);
 void	invdump(INVCONTROL *invcntl, char *term);
 long	invfind(INVCONTROL *invcntl, char *searchterm);
 int	invforward(INVCONTROL *invcntl);
 int	invopen(INVCONTROL *invcntl, char *invname, char *invpost, int status);
-long	invmake(char *invname, char *invpost, FILE *infile);
+long	invmake(char *invname, char *invpost, char *(*readposting)(TEMPPOSTING *p));
 long	invterm(INVCONTROL *invcntl, char *term);
 
 #endif /* CSCOPE_INVLIB_H */
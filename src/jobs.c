@@ -0,0 +1,188 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+/*	cscope - interactive C symbol cross-reference
+ *
+ *	parallel jobs in forked worker processes
+ *
+ *	A job is split into numbered tasks, which are handed out to the
+ *	workers through a pipe so a worker that finishes early picks up
+ *	more work.  Each task writes its results to its own files in the
+ *	private temp directory, and the parent collects them in task order
+ *	so the output does not depend on the number of workers.
+ */
+
+#include "global.h"
+#include "jobs.h"
+#include "alloc.h"
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <dirent.h>
+
+#define	JOBPREFIX	"cscope.j"	/* job file name prefix */
+
+int	njobs = 1;		/* maximum number of worker processes */
+BOOL	jobworker = NO;		/* this is a worker process */
+
+static	void	runtasks(int fd, JOBTASK fcn, void *arg);
+
+
+/* return the name of a task's temporary file */
+
+char *
+jobfile(int task, char *suffix)
+{
+    static char path[PATHLEN + 1];
+
+    if (snprintf(path, sizeof(path), "%s/%s%d%s", tempdirpv, JOBPREFIX,
+		 task, suffix) >= (int) sizeof(path)) {
+	postfatal("cscope: job file name in %s is too long\n", tempdirpv);
+	/* NOTREACHED */
+    }
+    return(path);
+}
+
+
+/* remove all job files from the private temp directory */
+
+void
+removejobfiles(void)
+{
+    DIR	*dirfile;
+    struct dirent *entry;
+    char path[PATHLEN + 1];
+
+    if (tempdirpv[0] == '\0' || (dirfile = opendir(tempdirpv)) == NULL) {
+	return;
+    }
+    while ((entry = readdir(dirfile)) != NULL) {
+	if (strncmp(entry->d_name, JOBPREFIX, sizeof(JOBPREFIX) - 1) == 0
+	    && snprintf(path, sizeof(path), "%s/%s", tempdirpv,
+			entry->d_name) < (int) sizeof(path)) {
+	    unlink(path);
+	}
+    }
+    closedir(dirfile);
+}
+
+
+/* run tasks 0 to ntasks - 1 in up to njobs worker processes, and wait
+   for them to finish; returns NO if a task failed or no worker could be
+   started, in which case the caller should do the work itself */
+
+BOOL
+runjobs(int ntasks, JOBTASK fcn, void *arg)
+{
+    int	p[2];
+    int	nworkers;
+    int	started;
+    int	task;
+    int	status;
+    int	i;
+    BOOL ok = YES;
+    pid_t *pids;
+    sighandler_t pipestat;
+
+    if ((nworkers = njobs) > ntasks) {
+	nworkers = ntasks;
+    }
+    if (nworkers <= 0 || pipe(p) < 0) {
+	return(NO);
+    }
+    pids = mymalloc(nworkers * sizeof(*pids));
+
+    /* don't let the workers inherit unwritten output */
+    fflush(NULL);
+    for (started = 0; started < nworkers; ++started) {
+	if ((pids[started] = fork()) == -1) {
+	    break;
+	}
+	if (pids[started] == 0) {
+	    close(p[1]);
+	    runtasks(p[0], fcn, arg);
+	    /* NOTREACHED */
+	}
+    }
+    close(p[0]);
+    if (started == 0) {
+	ok = NO;
+    }
+    /* hand out the task numbers; a write this small is atomic, so each
+       task is read by exactly one worker */
+    pipestat = signal(SIGPIPE, SIG_IGN);
+    for (task = 0; ok == YES && task < ntasks; ++task) {
+	if (write(p[1], &task, sizeof(task)) != sizeof(task)) {
+	    ok = NO;
+	}
+    }
+    close(p[1]);
+    (void) signal(SIGPIPE, pipestat);
+
+    /* wait for the workers */
+    for (i = 0; i < started; ++i) {
+	if (waitpid(pids[i], &status, 0) == -1
+	    || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+	    ok = NO;
+	}
+    }
+    free(pids);
+    return(ok);
+}
+
+
+/* worker process: run tasks until there are no more */
+
+static void
+runtasks(int fd, JOBTASK fcn, void *arg)
+{
+    int	task;
+    int	status = 0;
+
+    /* leave the parent's temporary files, database and terminal alone
+       if this process exits through myexit() */
+    temp1[0] = '\0';
+    remove_symfile_onexit = NO;
+    incurses = NO;
+    linemode = YES;
+    jobworker = YES;
+
+    while (read(fd, &task, sizeof(task)) == sizeof(task)) {
+	if ((*fcn)(task, arg) == NO) {
+	    status = 1;
+	    break;
+	}
+    }
+    _exit(status);
+}
@@ -43,6 +43,12 @@
 #include "version.h"	/* FILEVERSION and FIXVERSION */
 #include "scanner.h" 
 #include "alloc.h"
+#include "blocks.h"
+#include "buildstats.h"
+#include "shard.h"
+#include "jobs.h"
+#include "postsort.h"
+#include "trigram.h"
 
 #include <stdlib.h>	/* atoi */
 #if defined(USE_NCURSES) && !defined(RENAMED_NCURSES)
@@ -119,6 +125,9 @@ static	char	*reflines;		/* symbol reference lines file */
 static  void    error_usage(void);
 static	void	initcompress(void);
 static	void	longusage(void);
+static	void	setmemorylimit(char *megabytes);
+static	void	setoutline(char *pattern);
+static	void	setsubsetoption(char *pattern);
 static	void	skiplist(FILE *oldrefs);
 static	void	usage(void);
 
@@ -139,8 +148,21 @@ sigwinch_handler(int sig, siginfo_t *info, void *unused)
 #endif
 
 #ifdef HAVE_GETOPT_LONG
+#define	OPT_BUILDSTATS	256	/* --build-stats, which has no short form */
+#define	OPT_SHARDS	257	/* --shards, which has no short form */
+#define	OPT_MEMLIMIT	258	/* --memory-limit, which has no short form */
+#define	OPT_SUBSET	259	/* --subset, which has no short form */
+#define	OPT_OUTLINE	260	/* --outline, which has no short form */
+#define	OPT_TRIGRAMS	261	/* --trigrams, which has no short form */
+
 struct option lopts[] = {
+	{"build-stats", 2, NULL, OPT_BUILDSTATS},
 	{"help", 0, NULL, 'h'},
+	{"memory-limit", 1, NULL, OPT_MEMLIMIT},
+	{"outline", 1, NULL, OPT_OUTLINE},
+	{"shards", 2, NULL, OPT_SHARDS},
+	{"subset", 1, NULL, OPT_SUBSET},
+	{"trigrams", 0, NULL, OPT_TRIGRAMS},
 	{"version", 0, NULL, 'V'},
 	{0, 0, 0, 0}
 };
@@ -155,7 +177,7 @@ char ** parse_options(int *argc, char **argv)
 	
 
 	while ((opt = getopt_long(argcc, argv,
-	       "hVbcCdeF:f:I:i:kLl0:1:2:3:4:5:6:7:8:9:P:p:qRs:TUuvX",
+	       "hVbcCdeF:f:I:i:j:kLl0:1:2:3:4:5:6:7:8:9:P:p:qRs:TUuvXz",
 	       lopts, &longind)) != -1) {
 		switch(opt) {
 
@@ -166,6 +188,29 @@ char ** parse_options(int *argc, char **argv)
 		case 'X':
 			remove_symfile_onexit = YES;
 			break;
+		case 'z':	/* block-compress the crossref */
+			blockcompress = YES;
+			break;
+		case OPT_BUILDSTATS:	/* report build statistics */
+			buildstats = YES;
+			buildstatsfile = optarg;
+			break;
+		case OPT_SHARDS:	/* a database per directory */
+			sharded = YES;
+			shardroots = optarg;
+			break;
+		case OPT_MEMLIMIT:	/* build memory budget */
+			setmemorylimit(optarg);
+			break;
+		case OPT_SUBSET:	/* search only these files */
+			setsubsetoption(optarg);
+			break;
+		case OPT_OUTLINE:	/* definitions in these files */
+			setoutline(optarg);
+			break;
+		case OPT_TRIGRAMS:	/* index the text for searches */
+			trigramindex = YES;
+			break;
 		case '0':
 		case '1':
 		case '2':
@@ -253,6 +298,8 @@ char ** parse_options(int *argc, char **argv)
 			invname = my_strdup(path);
 			strcpy(s, ".po");
 			invpost = my_strdup(path);
+			strcpy(s, ".tg");
+			trigramfile = my_strdup(path);
 			break;
 
 		case 'F':	/* symbol reference lines file */
@@ -264,6 +311,14 @@ char ** parse_options(int *argc, char **argv)
 		case 'I':	/* #include file directory */
 			includedir(optarg);
 			break;
+		case 'j':	/* number of parallel build jobs */
+			if ((njobs = atoi(optarg)) < 1) {
+				fprintf(stderr, "\
+%s: -j option: missing or invalid numeric value\n", 
+					argv0);
+				error_usage();
+			}
+			break;
 		case 'p':	/* file path components to display */
 			dispcomponents = atoi(optarg);
 			break;
@@ -288,19 +343,18 @@ char ** parse_options(int *argc, char **argv)
 int
 main(int argc, char **argv)
 {
-    FILE *names;			/* name file pointer */
-    int	oldnum;			/* number in old cross-ref */
     char path[PATHLEN + 1];	/* file path */
-    FILE *oldrefs;	/* old cross-reference file */
     char *s;
     int c;
-    unsigned int i;
     pid_t pid;
     struct stat	stat_buf;
 #if defined(KEY_RESIZE) && !defined(__DJGPP__)
     struct sigaction winch_action;
 #endif
     mode_t orig_umask;
+    STATTIME statstart;		/* start of finding the source files */
+    char msg[MSGLEN + 1];	/* peak memory message */
+    long peak, jobpeak;		/* peak resident sizes in kilobytes */
 	
     yyin = stdin;
     yyout = stdout;
@@ -318,6 +372,38 @@ main(int argc, char **argv)
 	    longusage();
 	    myexit(0);
 	}
+	if (strncmp(argv[0], "--build-stats", 13) == 0
+	    && (argv[0][13] == '\0' || argv[0][13] == '=')) {
+	    buildstats = YES;
+	    if (argv[0][13] == '=') {
+		buildstatsfile = argv[0] + 14;
+	    }
+	    continue;
+	}
+	if (strncmp(argv[0], "--shards", 8) == 0
+	    && (argv[0][8] == '\0' || argv[0][8] == '=')) {
+	    sharded = YES;
+	    if (argv[0][8] == '=') {
+		shardroots = argv[0] + 9;
+	    }
+	    continue;
+	}
+	if (strncmp(argv[0], "--memory-limit=", 15) == 0) {
+	    setmemorylimit(argv[0] + 15);
+	    continue;
+	}
+	if (strncmp(argv[0], "--subset=", 9) == 0) {
+	    setsubsetoption(argv[0] + 9);
+	    continue;
+	}
+	if (strncmp(argv[0], "--outline=", 10) == 0) {
+	    setoutline(argv[0] + 10);
+	    continue;
+	}
+	if (strequal(argv[0], "--trigrams")) {
+	    trigramindex = YES;
+	    continue;
+	}
 	if (strequal(argv[0], "--version")
 	    || strequal(argv[0], "-V")) {
 #if CCS
@@ -403,10 +489,14 @@ cscope: pattern too long, cannot be > %d characters\n", PATLEN);
 		case 'X':
 		remove_symfile_onexit = YES;
 		break;
+	    case 'z':	/* block-compress the crossref */
+		blockcompress = YES;
+		break;
 	    case 'f':	/* alternate cross-reference file */
 	    case 'F':	/* symbol reference lines file */
 	    case 'i':	/* file containing file names */
 	    case 'I':	/* #include file directory */
+	    case 'j':	/* number of parallel build jobs */
 	    case 'p':	/* file path components to display */
 	    case 'P':	/* prepend path to file names */
 	    case 's':	/* additional source file directory */
@@ -441,6 +531,8 @@ cscope: reffile too long, cannot be > %d characters\n", sizeof(path) - 3);
 		    invname = my_strdup(path);
 		    strcpy(s, ".po");
 		    invpost = my_strdup(path);
+		    strcpy(s, ".tg");
+		    trigramfile = my_strdup(path);
 		    break;
 		case 'F':	/* symbol reference lines file */
 		    reflines = s;
@@ -451,6 +543,14 @@ cscope: reffile too long, cannot be > %d characters\n", sizeof(path) - 3);
 		case 'I':	/* #include file directory */
 		    includedir(s);
 		    break;
+		case 'j':	/* number of parallel build jobs */
+		    if ((njobs = atoi(s)) < 1) {
+			fprintf(stderr, "\
+%s: -j option: missing or invalid numeric value\n", 
+				argv0);
+			error_usage();
+		    }
+		    break;
 		case 'p':	/* file path components to display */
 		    if (*s < '0' || *s > '9' ) {
 			fprintf(stderr, "\
@@ -490,7 +590,9 @@ cscope: reffile too long, cannot be > %d characters\n", sizeof(path) - 3);
     lineflag = mygetenv("CSCOPE_LINEFLAG", LINEFLAG);
     lineflagafterfile = getenv("CSCOPE_LINEFLAG_AFTER_FILE") ? 1 : 0;
     tmpdir = mygetenv("TMPDIR", TMPDIR);
-
+    if ((s = getenv("CSCOPE_SORT_MEMORY")) != NULL && atol(s) > 0) {
+	sortmemory = atol(s) * 1024L * 1024L;
+    }
     /* XXX remove if/when clearerr() in dir.c does the right thing. */
     if (namefile && strcmp(namefile, "-") == 0 && !buildonly) {
 	postfatal("cscope: Must use -b if file list comes from stdin\n");
@@ -557,6 +659,8 @@ cscope: Could not create private temp dir %s\n",
 	    invname = my_strdup(path);
 	    snprintf(path, sizeof(path), "%s/%s", home, invpost);
 	    invpost = my_strdup(path);
+	    snprintf(path, sizeof(path), "%s/%s", home, trigramfile);
+	    trigramfile = my_strdup(path);
 	}
     }
 
@@ -589,121 +693,15 @@ cscope: Could not create private temp dir %s\n",
     }
 
 
+    /* a sharded cross-reference file lists the shards' databases */
+    if (readshards() == YES) {
+	sharded = YES;
+    }
     /* if the cross-reference is to be considered up-to-date */
     if (isuptodate == YES) {
-	if ((oldrefs = vpfopen(reffile, "rb")) == NULL) {
-	    postfatal("cscope: cannot open file %s\n", reffile);
-	    /* NOTREACHED */
-	}
-	/* get the crossref file version but skip the current directory */
-	if (fscanf(oldrefs, "cscope %d %*s", &fileversion) != 1) {
-	    postfatal("cscope: cannot read file version from file %s\n", 
-		      reffile);
-	    /* NOTREACHED */
-	}
-	if (fileversion >= 8) {
-
-	    /* override these command line options */
-	    compress = YES;
-	    invertedindex = NO;
-
-	    /* see if there are options in the database */
-	    for (;;) {
-		getc(oldrefs);	/* skip the blank */
-		if ((c = getc(oldrefs)) != '-') {
-		    ungetc(c, oldrefs);
-		    break;
-		}
-		switch (getc(oldrefs)) {
-		case 'c':	/* ASCII characters only */
-		    compress = NO;
-		    break;
-		case 'q':	/* quick search */
-		    invertedindex = YES;
-		    fscanf(oldrefs, "%ld", &totalterms);
-		    break;
-		case 'T':	/* truncate symbols to 8 characters */
-		    dbtruncated = YES;
-		    trun_syms = YES;
-		    break;
-		}
-	    }
-	    initcompress();
-	    seek_to_trailer(oldrefs);
-	}
-	/* skip the source and include directory lists */
-	skiplist(oldrefs);
-	skiplist(oldrefs);
-
-	/* get the number of source files */
-	if (fscanf(oldrefs, "%lu", &nsrcfiles) != 1) {
-	    postfatal("\
-cscope: cannot read source file size from file %s\n", reffile);
-	    /* NOTREACHED */
+	if (sharded == NO) {
+	    readcrossref();
 	}
-	/* get the source file list */
-	srcfiles = mymalloc(nsrcfiles * sizeof(*srcfiles));
-	if (fileversion >= 9) {
-
-	    /* allocate the string space */
-	    if (fscanf(oldrefs, "%d", &oldnum) != 1) {
-		postfatal("\
-cscope: cannot read string space size from file %s\n", reffile);
-		/* NOTREACHED */
-	    }
-	    s = mymalloc(oldnum);
-	    getc(oldrefs);	/* skip the newline */
-			
-	    /* read the strings */
-	    if (fread(s, oldnum, 1, oldrefs) != 1) {
-		postfatal("\
-cscope: cannot read source file names from file %s\n", reffile);
-		/* NOTREACHED */
-	    }
-	    /* change newlines to nulls */
-	    for (i = 0; i < nsrcfiles; ++i) {
-		srcfiles[i] = s;
-		for (++s; *s != '\n'; ++s) {
-		    ;
-		}
-		*s = '\0';
-		++s;
-	    }
-	    /* if there is a file of source file names */
-	    if ((namefile != NULL && (names = vpfopen(namefile, "r")) != NULL)
-		|| (names = vpfopen(NAMEFILE, "r")) != NULL) {
-	
-		/* read any -p option from it */
-		while (fgets(path, sizeof(path), names) != NULL && *path == '-') {
-		    i = path[1];
-		    s = path + 2;		/* for "-Ipath" */
-		    if (*s == '\0') {	/* if "-I path" */
-			fgets(path, sizeof(path), names);
-			s = path;
-		    }
-		    switch (i) {
-		    case 'p':	/* file path components to display */
-			if (*s < '0' || *s > '9') {
-			    posterr("cscope: -p option in file %s: missing or invalid numeric value\n", 								namefile);
-
-			}
-			dispcomponents = atoi(s);
-		    }
-		}
-		fclose(names);
-	    }
-	} else {
-	    for (i = 0; i < nsrcfiles; ++i) {
-		if (!fgets(path, sizeof(path), oldrefs) ) {
-		    postfatal("\
-cscope: cannot read source file name from file %s\n", 
-			      reffile);
-		    /* NOTREACHED */
-		}
-		srcfiles[i] = my_strdup(path);
-	    }
-	}
-	fclose(oldrefs);
     } else {
 	/* save the file arguments */
 	fileargc = argc;
@@ -715,11 +713,21 @@ cscope: cannot read source file name from file %s\n",
 	}
 	/* make the source file list */
 	srcfiles = mymalloc(msrcfiles * sizeof(*srcfiles));
+	stattime(&statstart);
 	makefilelist();
+	statphase(STATFILELIST, &statstart, 0, nsrcfiles);
 	if (nsrcfiles == 0) {
 	    postfatal("cscope: no source files found\n");
 	    /* NOTREACHED */
 	}
+	/* divide the build memory budget between the postings sort, the
+	   inverted index postings, and each job's scanner buffer, now
+	   that the options in the file of source file names are read */
+	if (memorylimit > 0) {
+	    sortmemory = memorylimit / 2;
+	    invpostmemory = memorylimit / 8;
+	    scanmemory = memorylimit / 8 / njobs;
+	}
 	/* get include directories from the environment */
 	if ((s = getenv("INCLUDEDIRS")) != NULL) {
 	    includedir(s);
@@ -744,14 +752,30 @@ cscope: cannot read source file name from file %s\n",
 	initcompress();
 	if (linemode == NO || verbosemode == YES)    /* display if verbose as well */
 	    postmsg("Building cross-reference...");    		    
-	build();
+	if (sharded == YES) {
+	    buildshards();
+	} else {
+	    build();
+	}
+	putbuildstats();
+	if (verbosemode == YES)
+	    srcnamestats();
+	if (memorylimit > 0) {
+	    peakmemory(&peak, &jobpeak);
+	    snprintf(msg, sizeof(msg),
+		     "cscope: peak resident size %ld KB, %ld KB in build jobs",
+		     peak, jobpeak);
+	    postmsg(msg);
+	}
 	if (linemode == NO )
 	    clearmsg();	/* clear any build progress message */
 	if (buildonly == YES) {
 	    myexit(0);
 	}
     }
-    opendatabase();
+    if (sharded == NO) {
+	opendatabase();
+    }
 
     /* if using the line oriented user interface so cscope can be a 
        subprocess to emacs or samuel */
@@ -794,7 +818,8 @@ cscope: cannot read source file name from file %s\n",
 	    case '7':
 	    case '8':
 	    case '9':	/* samuel only */
-		field = *buf - '0';
+	    case 'o':	/* definitions in files */
+		field = *buf == 'o' ? OUTLINE : *buf - '0';
 		strcpy(Pattern, buf + 1);
 		if (search() == NO) {
 			printf("Unable to search database\n");
@@ -921,6 +946,44 @@ cannotwrite(char *file)
 }
 
 
+/* set the build memory budget from the --memory-limit value */
+static void
+setmemorylimit(char *megabytes)
+{
+    if ((memorylimit = atol(megabytes) * 1024L * 1024L) <= 0) {
+	fprintf(stderr, "\
+%s: --memory-limit option: missing or invalid numeric value\n",
+		argv0);
+	error_usage();
+    }
+}
+
+/* limit searches to the files matching the --subset pattern */
+static void
+setsubsetoption(char *pattern)
+{
+    if (setsubset(pattern) == NO) {
+	fprintf(stderr, "\
+%s: --subset option: invalid regular expression %s\n",
+		argv0, pattern);
+	error_usage();
+    }
+}
+
+/* search for the definitions in the files matching the --outline
+   pattern */
+static void
+setoutline(char *pattern)
+{
+    if (strlen(pattern) > PATLEN) {
+	postfatal("\
+cscope: pattern too long, cannot be > %d characters\n", PATLEN);
+	/* NOTREACHED */
+    }
+    field = OUTLINE;
+    strcpy(Pattern, pattern);
+}
+
 /* set up the digraph character tables for text compression */
 static void
 initcompress(void)
@@ -937,6 +1000,143 @@ initcompress(void)
     }
 }
 
+/* read the options and source file list of an up-to-date
+   cross-reference */
+
+void
+readcrossref(void)
+{
+    FILE *names;		/* name file pointer */
+    FILE *oldrefs;		/* old cross-reference file */
+    int	oldnum;			/* number in old cross-ref */
+    char path[PATHLEN + 1];	/* file path */
+    char *s;
+    int c;
+    unsigned int i;
+
+    if ((oldrefs = vpfopen(reffile, "rb")) == NULL) {
+	postfatal("cscope: cannot open file %s\n", reffile);
+	/* NOTREACHED */
+    }
+    /* get the crossref file version but skip the current directory */
+    if (fscanf(oldrefs, "cscope %d %*s", &fileversion) != 1) {
+	postfatal("cscope: cannot read file version from file %s\n", 
+		  reffile);
+	/* NOTREACHED */
+    }
+    if (fileversion >= 8) {
+
+	/* override these command line options */
+	compress = YES;
+	invertedindex = NO;
+	blockcompress = NO;
+	blocktable = 0;
+
+	/* see if there are options in the database */
+	for (;;) {
+	    /* skip the blanks, which are padded where there is no -q */
+	    while ((c = getc(oldrefs)) == ' ')
+		;
+	    if (c != '-') {
+		ungetc(c, oldrefs);
+		break;
+	    }
+	    switch (getc(oldrefs)) {
+	    case 'c':	/* ASCII characters only */
+		compress = NO;
+		break;
+	    case 'q':	/* quick search */
+		invertedindex = YES;
+		fscanf(oldrefs, "%ld", &totalterms);
+		break;
+	    case 'T':	/* truncate symbols to 8 characters */
+		dbtruncated = YES;
+		trun_syms = YES;
+		break;
+	    case 'z':	/* block-compressed */
+		blockcompress = YES;
+		fscanf(oldrefs, "%ld", &blocktable);
+		break;
+	    }
+	}
+	initcompress();
+	seek_to_trailer(oldrefs);
+    }
+    /* skip the source and include directory lists */
+    skiplist(oldrefs);
+    skiplist(oldrefs);
+
+    /* get the number of source files */
+    if (fscanf(oldrefs, "%lu", &nsrcfiles) != 1) {
+	postfatal("\
+cscope: cannot read source file size from file %s\n", reffile);
+	/* NOTREACHED */
+    }
+    /* get the source file list */
+    srcfiles = mymalloc(nsrcfiles * sizeof(*srcfiles));
+    if (fileversion >= 9) {
+
+	/* allocate the string space */
+	if (fscanf(oldrefs, "%d", &oldnum) != 1) {
+	    postfatal("\
+cscope: cannot read string space size from file %s\n", reffile);
+	    /* NOTREACHED */
+	}
+	s = mymalloc(oldnum);
+	getc(oldrefs);	/* skip the newline */
+			
+	/* read the strings */
+	if (fread(s, oldnum, 1, oldrefs) != 1) {
+	    postfatal("\
+cscope: cannot read source file names from file %s\n", reffile);
+	    /* NOTREACHED */
+	}
+	/* change newlines to nulls */
+	for (i = 0; i < nsrcfiles; ++i) {
+	    srcfiles[i] = s;
+	    for (++s; *s != '\n'; ++s) {
+		;
+	    }
+	    *s = '\0';
+	    ++s;
+	}
+	/* if there is a file of source file names */
+	if ((namefile != NULL && (names = vpfopen(namefile, "r")) != NULL)
+	    || (names = vpfopen(NAMEFILE, "r")) != NULL) {
+	
+	    /* read any -p option from it */
+	    while (fgets(path, sizeof(path), names) != NULL && *path == '-') {
+		i = path[1];
+		s = path + 2;		/* for "-Ipath" */
+		if (*s == '\0') {	/* if "-I path" */
+		    fgets(path, sizeof(path), names);
+		    s = path;
+		}
+		switch (i) {
+		case 'p':	/* file path components to display */
+		    if (*s < '0' || *s > '9') {
+			posterr("cscope: -p option in file %s: missing or invalid numeric value\n", 								namefile);
+
+		    }
+		    dispcomponents = atoi(s);
+		}
+	    }
+	    fclose(names);
+	}
+    } else {
+	for (i = 0; i < nsrcfiles; ++i) {
+	    if (!fgets(path, sizeof(path), oldrefs) ) {
+		postfatal("\
+cscope: cannot read source file name from file %s\n", 
+			  reffile);
+		/* NOTREACHED */
+	    }
+	    srcfiles[i] = my_strdup(path);
+	}
+    }
+    fclose(oldrefs);
+}
+
 /* skip the list in the cross-reference file */
 
 static void
@@ -1004,8 +1204,11 @@ error_usage(void)
 static void
 usage(void)
 {
-	fprintf(stderr, "Usage: cscope [-bcCdehklLqRTuUvV] [-f file] [-F file] [-i file] [-I dir] [-s dir]\n");
-	fprintf(stderr, "              [-p number] [-P path] [-[0-8] pattern] [source files]\n");
+	fprintf(stderr, "Usage: cscope [-bcCdehklLqRTuUvVz] [-f file] [-F file] [-i file] [-I dir] [-s dir]\n");
+	fprintf(stderr, "              [-j jobs] [-p number] [-P path] [-[0-8] pattern]\n");
+	fprintf(stderr, "              [--build-stats[=file]] [--shards[=dirs]]\n");
+	fprintf(stderr, "              [--memory-limit=megabytes] [--subset=pattern]\n");
+	fprintf(stderr, "              [--outline=pattern] [--trigrams] [source files]\n");
 }
 
 
@@ -1027,7 +1230,9 @@ longusage(void)
 	fprintf(stderr, "\
 -h            This help screen.\n\
 -I incdir     Look in incdir for any #include files.\n\
--i namefile   Browse through files listed in namefile, instead of %s\n",
+-i namefile   Browse through files listed in namefile, instead of %s\n\
+-j jobs       Cross-reference and search the source files in up to jobs\n\
+              parallel processes.\n",
 		NAMEFILE);
 	fprintf(stderr, "\
 -k            Kernel Mode - don't use %s for #include files.\n",
@@ -1046,6 +1251,22 @@ longusage(void)
 -u            Unconditionally build the cross-reference file.\n\
 -v            Be more verbose in line mode.\n\
 -V            Print the version number.\n\
+-z            Compress the cross-ref file in blocks that are read separately.\n\
+--build-stats[=file]\n\
+              Report build phase times and sizes, appending them to file.\n\
+--shards[=dirs]\n\
+              Build a database per directory in dirs, or per top-level\n\
+              directory, and search them all.\n\
+--memory-limit=megabytes\n\
+              Keep the build within about megabytes of memory, sorting\n\
+              in temporary files, and report its peak resident size.\n\
+--subset=pattern\n\
+              Search only the files whose names match the regular expression.\n\
+--outline=pattern\n\
+              Find the definitions in the files matching the pattern.\n\
+--trigrams    Index the source files' text and names, and the -q index's\n\
+              symbols, for the text, egrep, file name, #include and\n\
+              symbol pattern searches.\n\
 \n\
 Please see the manpage for more information.\n",
 	      stderr);
@@ -1065,6 +1286,7 @@ myexit(int sig)
 	if (temp1[0] != '\0') {
 		unlink(temp1);
 		unlink(temp2);
+		removejobfiles();
 		rmdir(tempdirpv);		
 	}
 	/* restore the terminal to its original mode */
@@ -1086,6 +1308,7 @@ myexit(int sig)
 		unlink( reffile );
 		unlink( invname );
 		unlink( invpost );
+		unlink( trigramfile );
 	}
 
 	exit(sig);
@@ -0,0 +1,637 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+/*	cscope - interactive C symbol cross-reference
+ *
+ *	inverted index postings terms and sort
+ *
+ *	Each posting term is numbered once, so the postings temporary file
+ *	holds fixed-size records.  The records are sorted in memory if they
+ *	fit in the memory budget, with -j by parallel jobs that each sort a
+ *	part of them in memory shared with this process, and then merged.
+ *	Otherwise runs that fit are sorted, in parallel jobs when -j is
+ *	given, and written to the private temp directory, and then merged.
+ *	Terms are ordered byte by byte, which is the order `LC_ALL=C sort`
+ *	used to produce.
+ */
+
+#include "global.h"
+#include "alloc.h"
+#include "jobs.h"
+#include "postsort.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define	MAP_ANONYMOUS	MAP_ANON
+#endif
+
+#define	MERGEMAX	64		/* maximum runs merged at once */
+#define	MINRUNSIZE	(64 * 1024L)	/* minimum run size in bytes */
+#define	TERMINC		1024		/* term table size increment, a power of 2 */
+
+long	sortmemory = SORTMEMORY * 1024L * 1024L; /* sort memory budget */
+unsigned int nterms;		/* number of posting terms */
+
+typedef	struct {		/* sorted run being merged */
+	FILE	*file;		/* run file, or NULL for a part in memory */
+	TEMPPOSTING *next;	/* the part's next posting */
+	TEMPPOSTING *end;	/* the end of the part */
+	TEMPPOSTING post;	/* current posting */
+	int	number;		/* run number, to keep the merge stable */
+} RUN;
+
+static	char	**terms;	/* term names by term number */
+static	unsigned int *termchain; /* next term number + 1 with the same hash */
+static	unsigned int *termhash;	/* first term number + 1 for each hash */
+static	unsigned int maxterms;	/* size of the term tables */
+static	unsigned int *termrank;	/* sorted position of each term */
+static	char	*sortfile;	/* postings file being sorted */
+static	long	*runstart;	/* postings file offset of each run */
+static	char	**runnames;	/* sorted run file names */
+static	int	nrunnames;	/* number of sorted run files */
+static	TEMPPOSTING *posts;	/* postings sorted in memory */
+static	long	nposts;		/* number of postings */
+static	size_t	sharedsize;	/* size of posts if shared with jobs, or 0 */
+static	long	curpost;	/* next posting to return */
+static	RUN	*runs;		/* runs being merged */
+static	RUN	**heap;		/* runs ordered by their current posting */
+static	int	nheap;		/* runs in the heap */
+static	int	nruns;		/* runs being merged */
+
+static	int	compareposts(const void *p1, const void *p2);
+static	int	compareterms(const void *t1, const void *t2);
+static	void	closemerge(void);
+static	BOOL	mergeruns(int first, int count, char *name);
+static	BOOL	nextmerged(TEMPPOSTING *p);
+static	BOOL	openmerge(int first, int count);
+static	void	openparts(int count);
+static	BOOL	readrun(RUN *r);
+static	void	siftdown(int i);
+static	BOOL	sortpart(int part, void *arg);
+static	void	sortparts(long size);
+static	BOOL	sortrun(int run, void *arg);
+static	unsigned int termhashvalue(char *s);
+
+
+/* return the term number of the term, numbering it if it is new */
+
+unsigned int
+postterm(char *term)
+{
+    unsigned int h;
+    unsigned int i;
+
+    if (maxterms > 0) {
+	for (i = termhash[termhashvalue(term) & (maxterms - 1)]; i != 0;
+	     i = termchain[i - 1]) {
+	    if (strcmp(terms[i - 1], term) == 0) {
+		return(i - 1);
+	    }
+	}
+    }
+    /* double the tables when they are full and rehash the terms */
+    if (nterms == maxterms) {
+	maxterms = maxterms == 0 ? TERMINC : maxterms * 2;
+	terms = myrealloc(terms, maxterms * sizeof(*terms));
+	termchain = myrealloc(termchain, maxterms * sizeof(*termchain));
+	free(termhash);
+	termhash = mymalloc(maxterms * sizeof(*termhash));
+	memset(termhash, 0, maxterms * sizeof(*termhash));
+	for (i = 0; i < nterms; ++i) {
+	    h = termhashvalue(terms[i]) & (maxterms - 1);
+	    termchain[i] = termhash[h];
+	    termhash[h] = i + 1;
+	}
+    }
+    h = termhashvalue(term) & (maxterms - 1);
+    terms[nterms] = my_strdup(term);
+    termchain[nterms] = termhash[h];
+    termhash[h] = ++nterms;
+    return(nterms - 1);
+}
+
+
+/* return the name of a term number */
+
+char *
+posttermname(unsigned int term)
+{
+    return(terms[term]);
+}
+
+
+/* forget the posting terms */
+
+void
+freeterms(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < nterms; ++i) {
+	free(terms[i]);
+    }
+    free(terms);
+    free(termchain);
+    free(termhash);
+    terms = NULL;
+    termchain = termhash = NULL;
+    nterms = maxterms = 0;
+}
+
+
+/* sort the postings in the file, so nextposting() returns them in order */
+
+BOOL
+sortpostings(char *file)
+{
+    struct  stat statstruct;
+    FILE    *f;
+    unsigned int *order;	/* term numbers in name order */
+    unsigned int i;
+    long    size;		/* postings file size */
+    long    runsize;		/* bytes of postings per run */
+    long    offset;
+    int     run;
+    int     count;		/* number of runs */
+    int     first;
+#ifdef MAP_ANONYMOUS
+    void    *map;
+#endif
+
+    endsortpostings();
+    if (stat(file, &statstruct) != 0) {
+	return(NO);
+    }
+    size = statstruct.st_size - statstruct.st_size % sizeof(TEMPPOSTING);
+
+    /* rank the terms by name, so postings compare by number */
+    order = mymalloc((nterms + 1) * sizeof(*order));
+    for (i = 0; i < nterms; ++i) {
+	order[i] = i;
+    }
+    qsort(order, nterms, sizeof(*order), compareterms);
+    termrank = mymalloc((nterms + 1) * sizeof(*termrank));
+    for (i = 0; i < nterms; ++i) {
+	termrank[order[i]] = i;
+    }
+    free(order);
+
+    /* sort in memory if the postings fit */
+    if (size <= sortmemory) {
+	if ((f = myfopen(file, "rb")) == NULL) {
+	    return(NO);
+	}
+	nposts = size / sizeof(TEMPPOSTING);
+#ifdef MAP_ANONYMOUS
+	/* with -j, in memory shared with the jobs that sort its parts */
+	if (njobs >= 2 && size >= 2 * MINRUNSIZE
+	    && (map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_ANONYMOUS, -1, 0)) != MAP_FAILED) {
+	    posts = map;
+	    sharedsize = size;
+	}
+#endif
+	if (posts == NULL) {
+	    posts = mymalloc(size + 1);
+	}
+	if (fread(posts, sizeof(TEMPPOSTING), nposts, f) != (size_t) nposts) {
+	    fclose(f);
+	    return(NO);
+	}
+	fclose(f);
+	if (sharedsize > 0) {
+	    sortparts(size);
+	} else {
+	    qsort(posts, nposts, sizeof(TEMPPOSTING), compareposts);
+	}
+	curpost = 0;
+	return(YES);
+    }
+    /* split the postings into runs so the runs sorted at the same time
+       fit in the budget */
+    if ((runsize = sortmemory / njobs) < MINRUNSIZE) {
+	runsize = MINRUNSIZE;
+    }
+    runsize -= runsize % sizeof(TEMPPOSTING);
+    runstart = mymalloc((size / runsize + 2) * sizeof(*runstart));
+    for (count = 0, offset = 0; offset < size; offset += runsize) {
+	runstart[count++] = offset;
+    }
+    runstart[count] = size;
+
+    /* sort the runs */
+    sortfile = file;
+    if (njobs < 2 || runjobs(count, sortrun, NULL) == NO) {
+	for (run = 0; run < count; ++run) {
+	    if (sortrun(run, NULL) == NO) {
+		return(NO);
+	    }
+	}
+    }
+    runnames = mymalloc(count * sizeof(*runnames));
+    for (nrunnames = 0; nrunnames < count; ++nrunnames) {
+	runnames[nrunnames] = my_strdup(jobfile(nrunnames, ".s"));
+    }
+    free(runstart);
+    runstart = NULL;
+
+    /* merge groups of runs until they can be merged at once */
+    for (first = 0; nrunnames - first > MERGEMAX; first += MERGEMAX) {
+	runnames = myrealloc(runnames, (nrunnames + 1) * sizeof(*runnames));
+	runnames[nrunnames] = my_strdup(jobfile(nrunnames, ".s"));
+	if (mergeruns(first, MERGEMAX, runnames[nrunnames]) == NO) {
+	    return(NO);
+	}
+	++nrunnames;
+    }
+    return(openmerge(first, nrunnames - first));
+}
+
+
+/* get the next posting in sorted order and return its term name, or
+   return NULL after the last one */
+
+char *
+nextposting(TEMPPOSTING *p)
+{
+    if (posts != NULL && runs == NULL) {
+	if (curpost >= nposts) {
+	    return(NULL);
+	}
+	*p = posts[curpost++];
+    }
+    else if (nextmerged(p) == NO) {
+	return(NULL);
+    }
+    return(terms[p->term]);
+}
+
+
+/* free the sorted postings and remove the sorted runs */
+
+void
+endsortpostings(void)
+{
+    int     i;
+
+    closemerge();
+    for (i = 0; i < nrunnames; ++i) {
+	unlink(runnames[i]);
+	free(runnames[i]);
+    }
+    free(runnames);
+    runnames = NULL;
+    nrunnames = 0;
+    free(runstart);
+    runstart = NULL;
+    if (sharedsize > 0) {
+	munmap(posts, sharedsize);
+	sharedsize = 0;
+    } else {
+	free(posts);
+    }
+    posts = NULL;
+    nposts = curpost = 0;
+    free(termrank);
+    termrank = NULL;
+}
+
+
+/* compare term numbers by their names, for qsort */
+
+static int
+compareterms(const void *arg_t1, const void *arg_t2)
+{
+    const unsigned int *t1 = (const unsigned int *) arg_t1;
+    const unsigned int *t2 = (const unsigned int *) arg_t2;
+
+    return(strcmp(terms[*t1], terms[*t2]));
+}
+
+
+/* compare postings by term name and then by offset and type, which
+   orders a term's references as they appear in the database */
+
+static int
+compareposts(const void *arg_p1, const void *arg_p2)
+{
+    const TEMPPOSTING *p1 = (const TEMPPOSTING *) arg_p1;
+    const TEMPPOSTING *p2 = (const TEMPPOSTING *) arg_p2;
+
+    if (p1->term != p2->term) {
+	return(termrank[p1->term] < termrank[p2->term] ? -1 : 1);
+    }
+    if (p1->fileindex != p2->fileindex) {
+	return(p1->fileindex < p2->fileindex ? -1 : 1);
+    }
+    if (p1->lineoffset != p2->lineoffset) {
+	return(p1->lineoffset < p2->lineoffset ? -1 : 1);
+    }
+    if (p1->type != p2->type) {
+	return(p1->type < p2->type ? -1 : 1);
+    }
+    if (p1->fcnoffset != p2->fcnoffset) {
+	return(p1->fcnoffset < p2->fcnoffset ? -1 : 1);
+    }
+    return(0);
+}
+
+
+/* form the hash value of a term */
+
+static unsigned int
+termhashvalue(char *s)
+{
+    unsigned int h = 0;
+
+    while (*s != '\0') {
+	h = h * 31 + (unsigned char) *s++;
+    }
+    return(h);
+}
+
+
+/* sort a run of the postings file into its own file */
+
+static BOOL
+sortrun(int run, void *arg)
+{
+    FILE    *f;
+    TEMPPOSTING *p;
+    long    n = (runstart[run + 1] - runstart[run]) / sizeof(TEMPPOSTING);
+    BOOL    ok = YES;
+
+    (void) arg;
+    if ((f = myfopen(sortfile, "rb")) == NULL) {
+	return(NO);
+    }
+    p = mymalloc(n * sizeof(*p) + 1);
+    if (fseek(f, runstart[run], SEEK_SET) == -1
+	|| fread(p, sizeof(*p), n, f) != (size_t) n) {
+	fclose(f);
+	free(p);
+	return(NO);
+    }
+    fclose(f);
+    qsort(p, n, sizeof(*p), compareposts);
+    if ((f = myfopen(jobfile(run, ".s"), "wb")) == NULL) {
+	ok = NO;
+    } else {
+	if (fwrite(p, sizeof(*p), n, f) != (size_t) n) {
+	    ok = NO;
+	}
+	if (fclose(f) == EOF) {
+	    ok = NO;
+	}
+    }
+    free(p);
+    return(ok);
+}
+
+
+/* sort the postings in memory in parts, one for each job, and open the
+   parts for merging */
+
+static void
+sortparts(long size)
+{
+    long    partsize;		/* postings per part */
+    long    offset;
+    int     count;		/* number of parts */
+    int     part;
+
+    if ((partsize = size / njobs) < MINRUNSIZE) {
+	partsize = MINRUNSIZE;
+    }
+    partsize = (partsize + sizeof(TEMPPOSTING) - 1) / sizeof(TEMPPOSTING);
+    runstart = mymalloc((nposts / partsize + 2) * sizeof(*runstart));
+    for (count = 0, offset = 0; offset < nposts; offset += partsize) {
+	runstart[count++] = offset;
+    }
+    runstart[count] = nposts;
+    if (runjobs(count, sortpart, NULL) == NO) {
+	for (part = 0; part < count; ++part) {
+	    (void) sortpart(part, NULL);
+	}
+    }
+    openparts(count);
+    free(runstart);
+    runstart = NULL;
+}
+
+
+/* sort a part of the postings in memory */
+
+static BOOL
+sortpart(int part, void *arg)
+{
+    (void) arg;
+    qsort(posts + runstart[part], runstart[part + 1] - runstart[part],
+	  sizeof(TEMPPOSTING), compareposts);
+    return(YES);
+}
+
+
+/* merge count runs starting at first into the named file */
+
+static BOOL
+mergeruns(int first, int count, char *name)
+{
+    FILE    *f;
+    TEMPPOSTING p;
+    int     i;
+    BOOL    ok = YES;
+
+    if (openmerge(first, count) == NO
+	|| (f = myfopen(name, "wb")) == NULL) {
+	closemerge();
+	return(NO);
+    }
+    while (nextmerged(&p) == YES) {
+	if (fwrite(&p, sizeof(p), 1, f) != 1) {
+	    ok = NO;
+	    break;
+	}
+    }
+    if (fclose(f) == EOF) {
+	ok = NO;
+    }
+    closemerge();
+
+    /* the merged runs are no longer needed */
+    for (i = first; i < first + count; ++i) {
+	unlink(runnames[i]);
+    }
+    return(ok);
+}
+
+
+/* open count runs starting at first for merging */
+
+static BOOL
+openmerge(int first, int count)
+{
+    RUN     *r;
+    int     i;
+
+    runs = mymalloc(count * sizeof(*runs));
+    heap = mymalloc(count * sizeof(*heap));
+    nruns = nheap = 0;
+    for (i = 0; i < count; ++i) {
+	r = &runs[nruns];
+	if ((r->file = myfopen(runnames[first + i], "rb")) == NULL) {
+	    closemerge();
+	    return(NO);
+	}
+	r->number = i;
+	++nruns;
+	if (readrun(r) == YES) {
+	    heap[nheap++] = r;
+	}
+    }
+    for (i = nheap / 2 - 1; i >= 0; --i) {
+	siftdown(i);
+    }
+    return(YES);
+}
+
+
+/* open the count sorted parts of the postings in memory for merging */
+
+static void
+openparts(int count)
+{
+    RUN     *r;
+    int     i;
+
+    runs = mymalloc(count * sizeof(*runs));
+    heap = mymalloc(count * sizeof(*heap));
+    nruns = nheap = 0;
+    for (i = 0; i < count; ++i) {
+	r = &runs[nruns++];
+	r->file = NULL;
+	r->next = posts + runstart[i];
+	r->end = posts + runstart[i + 1];
+	r->number = i;
+	if (readrun(r) == YES) {
+	    heap[nheap++] = r;
+	}
+    }
+    for (i = nheap / 2 - 1; i >= 0; --i) {
+	siftdown(i);
+    }
+}
+
+
+/* close the runs being merged */
+
+static void
+closemerge(void)
+{
+    int     i;
+
+    for (i = 0; i < nruns; ++i) {
+	if (runs[i].file != NULL) {
+	    fclose(runs[i].file);
+	}
+    }
+    free(runs);
+    free(heap);
+    runs = NULL;
+    heap = NULL;
+    nruns = nheap = 0;
+}
+
+
+/* get the next posting of the merged runs */
+
+static BOOL
+nextmerged(TEMPPOSTING *p)
+{
+    RUN     *r;
+
+    if (nheap == 0) {
+	return(NO);
+    }
+    r = heap[0];
+    *p = r->post;
+    if (readrun(r) == NO) {
+	heap[0] = heap[--nheap];
+    }
+    siftdown(0);
+    return(YES);
+}
+
+
+/* read the next posting of a run */
+
+static BOOL
+readrun(RUN *r)
+{
+    if (r->file == NULL) {
+	if (r->next == r->end) {
+	    return(NO);
+	}
+	r->post = *r->next++;
+	return(YES);
+    }
+    return(fread(&r->post, sizeof(r->post), 1, r->file) == 1 ? YES : NO);
+}
+
+
+/* restore the heap order below heap[i] */
+
+static void
+siftdown(int i)
+{
+    RUN     *r = heap[i];
+    int     child;
+    int     cmp;
+
+    while ((child = 2 * i + 1) < nheap) {
+	if (child + 1 < nheap
+	    && ((cmp = compareposts(&heap[child + 1]->post,
+				    &heap[child]->post)) < 0
+		|| (cmp == 0 && heap[child + 1]->number < heap[child]->number))) {
+	    ++child;
+	}
+	if ((cmp = compareposts(&heap[child]->post, &r->post)) > 0
+	    || (cmp == 0 && heap[child]->number > r->number)) {
+	    break;
+	}
+	heap[i] = heap[child];
+	i = child;
+    }
+    heap[i] = r;
+}
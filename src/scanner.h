@@ -72,6 +72,7 @@ extern	int	lineno;		/* symbol line number */
 extern	FILE	*yyin;		/* input file descriptor */
 extern	FILE	*yyout;		/* output file */
 extern	int	myylineno;	/* input line number */
+extern	size_t	scanmemory;	/* largest scanner buffer kept, or 0 */
 
 #ifdef USING_LEX
 /* HBB 20010430: if lex is used instead of flex, have to simulate the
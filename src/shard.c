@@ -0,0 +1,766 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+/*	cscope - interactive C symbol cross-reference
+ *
+ *	sharded cross-references
+ *
+ *	The --shards option splits the cross-reference into a database for
+ *	each shard root directory and one for the files under none of them,
+ *	so a change under one root rebuilds only that root's database.  The
+ *	cross-reference file then lists the shards instead, and a search
+ *	runs on the shards in parallel jobs whose references are merged in
+ *	the order of a single database: by the build pass that found each
+ *	file, the source files first and then each level of #included
+ *	files, and by name within a pass.  So the cross-reference file also
+ *	lists where each shard's passes start.  An #included file outside
+ *	every shard's source files may be in more than one shard, so only
+ *	the first shard with references in a file keeps them.
+ */
+
+#include "global.h"
+#include "alloc.h"
+#include "build.h"
+#include "jobs.h"
+#include "shard.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#define	SHARDHEADER	"cscope shards"	/* cross-reference file shard list */
+#define	RESTROOT	"."	/* root of the shard of files under no other */
+#define	ROOTSEPS	" ,:"	/* --shards root directory separators */
+
+typedef	struct {		/* shard references being merged */
+	FILE	*refs;		/* references file */
+	FILE	*passes;	/* build pass of each file's lines, or NULL */
+	char	name[PATHLEN + 1]; /* file name starting its next line */
+	int	pass;		/* build pass that found that file */
+	int	sep;		/* character after that name, or EOF */
+	char	last[PATHLEN + 1]; /* file name of the last line */
+	BOOL	keep;		/* keep the last file's lines */
+} SHARDREFS;
+
+BOOL	sharded = NO;		/* the cross-reference is split into shards */
+char	*shardroots;		/* --shards option's root directories, or NULL */
+
+static	char	**roots;	/* shard root directories given */
+static	int	nroots;		/* number of them */
+static	char	**shards;	/* root directory of each shard */
+static	int	nshards;	/* number of shards */
+static	char	**shardpasses;	/* each shard's pass count and pass starts */
+static	int	nshardpasses;	/* number of them */
+
+/* Internal prototypes: */
+static	void	addpasses(char *root, char **oldlist, int noldlist,
+			  char **oldpasses, int noldpasses);
+static	void	addtolist(char ***list, int *count, char *name);
+static	int	comparenames(const void *s1, const void *s2);
+static	int	filepass(char *name, unsigned long *starts, int count);
+static	void	freelist(char ***list, int *count);
+static	int	getpasses(int shard, unsigned long **starts);
+static	void	getrefname(SHARDREFS *r);
+static	int	*makeshards(char **files, unsigned long nfiles);
+static	void	mergerefs(char *suffix, char *passsuffix, FILE *output);
+static	void	parseroots(void);
+static	BOOL	putpasses(int task, char *suffix, char *passsuffix,
+			  unsigned long *starts, int count);
+static	void	putshardref(SHARDREFS *r, NAMETABLE *seen, FILE *output);
+static	void	putshards(void);
+static	BOOL	readshardlist(char ***list, int *count, char ***rootlist,
+			      int *nrootlist, char ***passlist,
+			      int *npasslist);
+static	BOOL	searchtask(int task, void *arg);
+static	char	*shardfile(char *root, char *suffix);
+static	void	useshard(int shard);
+
+
+/* read the shard list if the cross-reference is sharded */
+
+BOOL
+readshards(void)
+{
+    parseroots();
+    return(readshardlist(&shards, &nshards,
+			 shardroots == NULL ? &roots : NULL, &nroots,
+			 &shardpasses, &nshardpasses));
+}
+
+
+/* build each shard's database and list the shards in the
+   cross-reference file */
+
+void
+buildshards(void)
+{
+    char    **allfiles = srcfiles;	/* whole source file list */
+    unsigned long nallfiles = nsrcfiles;
+    char    **oldshards = NULL;		/* shards before this build */
+    int	    noldshards = 0;
+    char    **oldpasses = NULL;		/* their pass lists */
+    int	    noldpasses = 0;
+    char    *ref = reffile;
+    char    *inv = invname;
+    char    *post = invpost;
+    int	    *owner;
+    unsigned long i;
+    int	    k;
+
+    parseroots();
+    readshardlist(&oldshards, &noldshards, NULL, NULL,
+		  &oldpasses, &noldpasses);
+    owner = makeshards(allfiles, nallfiles);
+    freelist(&shardpasses, &nshardpasses);
+
+    /* build each shard from its own files.  The other shards' files
+       are marked as listed so an #include of one is left to its shard */
+    srcfiles = NULL;
+    nsrcfiles = 0;
+    msrcfiles = 0;
+    for (k = 0; k < nshards; ++k) {
+	freefilelist();
+	for (i = 0; i < nallfiles; ++i) {
+	    if (owner[i] == k) {
+		addsrcfile(allfiles[i]);
+	    } else {
+		skipsrcfile(allfiles[i]);
+	    }
+	}
+	useshard(k);
+	setup_build_filenames(reffile);
+	nsrcoffset = 0;
+	npostings = 0;
+	build();
+	addpasses(shards[k], oldshards, noldshards, oldpasses, noldpasses);
+    }
+    freefilelist();
+    free(owner);
+    reffile = ref;
+    invname = inv;
+    invpost = post;
+    setup_build_filenames(reffile);
+
+    /* remove the databases of shards there are no longer files for */
+    for (k = 0; k < noldshards; ++k) {
+	if (bsearch(&oldshards[k], shards, nshards, sizeof(*shards),
+		    comparenames) == NULL) {
+	    unlink(shardfile(oldshards[k], ".out"));
+	    unlink(shardfile(oldshards[k], ".in"));
+	    unlink(shardfile(oldshards[k], ".po"));
+	}
+    }
+    freelist(&oldshards, &noldshards);
+    freelist(&oldpasses, &noldpasses);
+    putshards();
+
+    /* put the whole source file list back */
+    for (i = 0; i < nallfiles; ++i) {
+	addsrcfile(allfiles[i]);
+	free(allfiles[i]);
+    }
+    free(allfiles);
+}
+
+
+/* search every shard for the current field's pattern, putting the
+   global references in refsfound and the non-global ones in
+   nonglobalrefs, and return the first shard's find function result */
+
+char *
+findshards(FINDINIT *rc, BOOL *funcexist)
+{
+    static char result[MSGLEN + 1];	/* find function result */
+    char    *findresult = NULL;
+    FILE    *status;
+    BOOL    exists = NO;
+    int	    taskrc, taskexists, hasresult;
+    int	    k;
+
+    if (runjobs(nshards, searchtask, NULL) == NO) {
+	posterr("cscope: cannot search the cross-reference shards\n");
+	removejobfiles();
+	return(NULL);
+    }
+    for (k = 0; k < nshards; ++k) {
+	if ((status = myfopen(jobfile(k, ".s"), "r")) == NULL) {
+	    continue;
+	}
+	if (fscanf(status, "%d %d %d ", &taskrc, &taskexists,
+		   &hasresult) == 3) {
+	    if (taskrc != NOERROR) {
+		*rc = taskrc;
+	    }
+	    if (taskexists == YES) {
+		exists = YES;
+	    }
+	    if (hasresult == YES && findresult == NULL
+		&& fgets(result, sizeof(result), status) != NULL) {
+		result[strcspn(result, "\n")] = '\0';
+		findresult = result;
+	    }
+	}
+	fclose(status);
+    }
+    *funcexist = exists;
+
+    mergerefs(".r", ".rp", refsfound);
+    mergerefs(".n", ".np", nonglobalrefs);
+    removejobfiles();
+    return(findresult);
+}
+
+
+/* search job task: search one shard, writing its global and non-global
+   references, the build pass of their files, and the find function's
+   result to the task's files */
+
+static BOOL
+searchtask(int task, void *arg)
+{
+    FILE    *status;
+    FINDINIT rc = NOERROR;
+    BOOL    funcexist = YES;
+    char    *findresult;
+    unsigned long *starts;	/* first file of each build pass */
+    int	    count;		/* number of passes */
+    BOOL    ok;
+
+    (void) arg;
+    /* an interrupt stops the search in the parent, so just stop */
+    signal(SIGINT, SIG_DFL);
+    if ((refsfound = myfopen(jobfile(task, ".r"), "wb")) == NULL
+	|| (nonglobalrefs = myfopen(jobfile(task, ".n"), "wb")) == NULL
+	|| (status = myfopen(jobfile(task, ".s"), "w")) == NULL) {
+	return(NO);
+    }
+    useshard(task);
+    isuptodate = YES;	/* so freefilelist() frees the list it reads */
+    readcrossref();
+    opendatabase();
+    findresult = findrefs(&rc, &funcexist);
+    fprintf(status, "%d %d %d %s\n", rc, funcexist, findresult != NULL,
+	    findresult != NULL ? findresult : "");
+    ok = fclose(refsfound) != EOF && fclose(nonglobalrefs) != EOF
+	&& fclose(status) != EOF;
+    if (ok == YES && (count = getpasses(task, &starts)) > 0) {
+	ok = putpasses(task, ".r", ".rp", starts, count) == YES
+	    && putpasses(task, ".n", ".np", starts, count) == YES;
+	free(starts);
+    }
+
+    /* leave this worker ready for another shard */
+    unmapdatabase();
+    close(symrefs);
+    if (invertedindex == YES) {
+	invclose(&invcontrol);
+    }
+    freefilelist();
+    return(ok);
+}
+
+
+/* write the build pass of the file of each run of lines in a search
+   job's references file to the file with the pass suffix */
+
+static BOOL
+putpasses(int task, char *suffix, char *passsuffix, unsigned long *starts,
+	  int count)
+{
+    FILE    *refs;
+    FILE    *passes;
+    char    name[PATHLEN + 1];
+    char    last[PATHLEN + 1];	/* file name of the last line */
+    int	    c;
+
+    if ((refs = myfopen(jobfile(task, suffix), "rb")) == NULL) {
+	return(NO);
+    }
+    if ((passes = myfopen(jobfile(task, passsuffix), "w")) == NULL) {
+	fclose(refs);
+	return(NO);
+    }
+    last[0] = '\0';
+    while (fscanf(refs, "%" PATHLEN_STR "s", name) == 1) {
+	if (strcmp(name, last) != 0) {
+	    fprintf(passes, "%d\n", filepass(name, starts, count));
+	    strcpy(last, name);
+	}
+	while ((c = getc(refs)) != EOF && c != '\n') {
+	    ;
+	}
+    }
+    fclose(refs);
+    return(fclose(passes) != EOF);
+}
+
+
+/* return the build pass that found a file in the shard's list, given
+   the first file of each pass, or 0 if it is not in the list */
+
+static int
+filepass(char *name, unsigned long *starts, int count)
+{
+    unsigned long end = nsrcfiles;	/* end of the pass's files */
+    int	    pass;
+
+    /* the files of a pass are in name order */
+    for (pass = count - 1; pass >= 0; --pass) {
+	if (starts[pass] >= end) {
+	    continue;
+	}
+	if (bsearch(&name, srcfiles + starts[pass], end - starts[pass],
+		    sizeof(*srcfiles), comparenames) != NULL) {
+	    return(pass);
+	}
+	end = starts[pass];
+    }
+    return(0);
+}
+
+
+/* merge the shards' references files with the suffix into the output
+   by the build pass of their files and by file name, the order of each
+   database, leaving out the lines of a file that an earlier shard
+   already had lines for */
+
+static void
+mergerefs(char *suffix, char *passsuffix, FILE *output)
+{
+    SHARDREFS *refs;
+    SHARDREFS *next;
+    NAMETABLE seen;		/* files with lines output */
+    int	    k;
+
+    refs = mymalloc(nshards * sizeof(*refs));
+    memset(&seen, 0, sizeof(seen));
+    for (k = 0; k < nshards; ++k) {
+	refs[k].last[0] = '\0';
+	refs[k].passes = myfopen(jobfile(k, passsuffix), "r");
+	if ((refs[k].refs = myfopen(jobfile(k, suffix), "rb")) == NULL) {
+	    refs[k].sep = EOF;
+	    refs[k].name[0] = '\0';
+	} else {
+	    getrefname(&refs[k]);
+	}
+    }
+    for (;;) {
+	next = NULL;
+	for (k = 0; k < nshards; ++k) {
+	    if ((refs[k].sep != EOF || refs[k].name[0] != '\0')
+		&& (next == NULL || refs[k].pass < next->pass
+		    || (refs[k].pass == next->pass
+			&& strcmp(refs[k].name, next->name) < 0))) {
+		next = &refs[k];
+	    }
+	}
+	if (next == NULL) {
+	    break;
+	}
+	putshardref(next, &seen, output);
+    }
+    for (k = 0; k < nshards; ++k) {
+	if (refs[k].refs != NULL) {
+	    fclose(refs[k].refs);
+	}
+	if (refs[k].passes != NULL) {
+	    fclose(refs[k].passes);
+	}
+    }
+    freenames(&seen, YES);
+    free(refs);
+}
+
+
+/* copy a shard's next reference line to the output, if its file's
+   lines are not from another shard, and get the file name starting the
+   line after */
+
+static void
+putshardref(SHARDREFS *r, NAMETABLE *seen, FILE *output)
+{
+    char    **slot;
+    int	    c;
+
+    if (strcmp(r->name, r->last) != 0) {
+	strcpy(r->last, r->name);
+	if (*(slot = findname(seen, r->name)) == NULL) {
+	    *slot = my_strdup(r->name);
+	    ++seen->count;
+	    r->keep = YES;
+	} else {
+	    r->keep = NO;
+	}
+    }
+    if (r->keep == YES) {
+	fputs(r->name, output);
+    }
+    for (c = r->sep; c != EOF; c = getc(r->refs)) {
+	if (r->keep == YES) {
+	    putc(c, output);
+	}
+	if (c == '\n') {
+	    break;
+	}
+    }
+    getrefname(r);
+}
+
+
+/* read the file name that starts a reference line, and the build pass
+   of its file if it is not that of the last line */
+
+static void
+getrefname(SHARDREFS *r)
+{
+    char    *s = r->name;
+    int	    c;
+
+    while ((c = getc(r->refs)) != EOF && c != ' ' && c != '\n') {
+	if (s < r->name + PATHLEN) {
+	    *s++ = c;
+	}
+    }
+    *s = '\0';
+    r->sep = c;
+    if (strcmp(r->name, r->last) != 0
+	&& (r->passes == NULL || fscanf(r->passes, "%d", &r->pass) != 1)) {
+	r->pass = 0;
+    }
+}
+
+
+/* make the shard list and find the shard of each source file: that
+   of the longest root given it is under, or with no roots given, that
+   of the first directory in its path */
+
+static int *
+makeshards(char **files, unsigned long nfiles)
+{
+    char    root[PATHLEN + 1];
+    char    **shardof;		/* shard root of each file */
+    char    *s;
+    int	    *owner;
+    char    **found;
+    unsigned long i;
+    size_t  best, len;
+    int	    k;
+
+    freelist(&shards, &nshards);
+    shardof = mymalloc(nfiles * sizeof(*shardof));
+    for (i = 0; i < nfiles; ++i) {
+	s = RESTROOT;
+	if (nroots > 0) {
+	    best = 0;
+	    for (k = 0; k < nroots; ++k) {
+		len = strlen(roots[k]);
+		if (len > best && strncmp(files[i], roots[k], len) == 0
+		    && (files[i][len] == '/' || files[i][len] == '\0')) {
+		    best = len;
+		    s = roots[k];
+		}
+	    }
+	} else if (files[i][0] != '/' && strchr(files[i], '/') != NULL) {
+	    snprintf(root, sizeof(root), "%.*s",
+		     (int) strcspn(files[i], "/"), files[i]);
+	    s = root;
+	}
+	/* files in the same directory are usually together */
+	if (nshards == 0 || strcmp(shards[nshards - 1], s) != 0) {
+	    for (k = 0; k < nshards && strcmp(shards[k], s) != 0; ++k) {
+		;
+	    }
+	    if (k == nshards) {
+		addtolist(&shards, &nshards, s);
+	    } else {
+		/* keep the last shard found at the end for the next file */
+		s = shards[k];
+		shards[k] = shards[nshards - 1];
+		shards[nshards - 1] = s;
+	    }
+	}
+	shardof[i] = shards[nshards - 1];
+    }
+    qsort(shards, nshards, sizeof(*shards), comparenames);
+    owner = mymalloc((nfiles + 1) * sizeof(*owner));
+    for (i = 0; i < nfiles; ++i) {
+	found = bsearch(&shardof[i], shards, nshards, sizeof(*shards),
+			comparenames);
+	owner[i] = found - shards;
+    }
+    free(shardof);
+    return(owner);
+}
+
+
+/* get the shard roots given with the --shards option */
+
+static void
+parseroots(void)
+{
+    char    *list;
+    char    *dir;
+    char    *end;
+
+    if (shardroots == NULL || roots != NULL) {
+	return;
+    }
+    list = my_strdup(shardroots);
+    for (dir = strtok(list, ROOTSEPS); dir != NULL;
+	 dir = strtok(NULL, ROOTSEPS)) {
+	dir = compath(dir);
+	if ((end = dir + strlen(dir)) > dir + 1 && end[-1] == '/') {
+	    end[-1] = '\0';
+	}
+	addtolist(&roots, &nroots, dir);
+    }
+    free(list);
+}
+
+
+/* add a shard's pass count and the first file of each pass after the
+   first to the pass lists, from its build, or from the old shard list
+   if its database was up-to-date; a count of 0 means not known */
+
+static void
+addpasses(char *root, char **oldlist, int noldlist, char **oldpasses,
+	  int noldpasses)
+{
+    char    list[PATHLEN + 1];
+    char    **found;
+    size_t  len;
+    int	    i;
+
+    if (npasses > 0) {
+	len = snprintf(list, sizeof(list), "%d", npasses);
+	for (i = 1; i < npasses && len < sizeof(list); ++i) {
+	    len += snprintf(list + len, sizeof(list) - len, " %lu",
+			    passstart[i]);
+	}
+	if (len >= sizeof(list)) {
+	    strcpy(list, "0");
+	}
+    } else if ((found = bsearch(&root, oldlist, noldlist, sizeof(*oldlist),
+				comparenames)) != NULL
+	       && found - oldlist < noldpasses) {
+	strcpy(list, oldpasses[found - oldlist]);
+    } else {
+	strcpy(list, "0");
+    }
+    addtolist(&shardpasses, &nshardpasses, list);
+}
+
+
+/* get the first file of each build pass of a shard from its pass list,
+   returning the number of passes, or 0 if they are not known */
+
+static int
+getpasses(int shard, unsigned long **starts)
+{
+    char    *s;
+    char    *end;
+    int	    count;
+    int	    i;
+
+    *starts = NULL;
+    if (shard >= nshardpasses
+	|| (count = strtol(shardpasses[shard], &end, 10)) <= 0) {
+	return(0);
+    }
+    *starts = mymalloc(count * sizeof(**starts));
+    (*starts)[0] = 0;
+    for (i = 1; i < count; ++i) {
+	s = end;
+	(*starts)[i] = strtoul(s, &end, 10);
+	if (end == s) {
+	    free(*starts);
+	    *starts = NULL;
+	    return(0);
+	}
+    }
+    return(count);
+}
+
+
+/* list the shards, any roots given, and the shards' pass lists in the
+   cross-reference file */
+
+static void
+putshards(void)
+{
+    FILE    *list;
+    int	    k;
+
+    if ((list = myfopen(reffile, "wb")) == NULL) {
+	cannotwrite(reffile);
+	/* NOTREACHED */
+    }
+    fprintf(list, "%s %d %d\n", SHARDHEADER, nshards, nroots);
+    for (k = 0; k < nshards; ++k) {
+	fprintf(list, "%s\n", shards[k]);
+    }
+    for (k = 0; k < nroots; ++k) {
+	fprintf(list, "%s\n", roots[k]);
+    }
+    for (k = 0; k < nshardpasses; ++k) {
+	fprintf(list, "%s\n", shardpasses[k]);
+    }
+    if (fclose(list) == EOF) {
+	cannotwrite(reffile);
+	/* NOTREACHED */
+    }
+}
+
+
+/* read the shard list, the roots given if rootlist is not NULL, and
+   the shards' pass lists, which an older shard list does not have,
+   from the cross-reference file; returns NO if it is not sharded */
+
+static BOOL
+readshardlist(char ***list, int *count, char ***rootlist, int *nrootlist,
+	      char ***passlist, int *npasslist)
+{
+    FILE    *refs;
+    char    name[PATHLEN + 1];
+    int	    n, nr;
+    int	    i;
+
+    if ((refs = vpfopen(reffile, "rb")) == NULL) {
+	return(NO);
+    }
+    if (fscanf(refs, SHARDHEADER " %d %d", &n, &nr) != 2) {
+	fclose(refs);
+	return(NO);
+    }
+    freelist(list, count);
+    if (rootlist != NULL) {
+	freelist(rootlist, nrootlist);
+    }
+    for (i = 0; i < n + nr; ++i) {
+	if (fscanf(refs, " %[^\n]", name) != 1) {
+	    postfatal("cscope: cannot read shard list from file %s\n",
+		      reffile);
+	    /* NOTREACHED */
+	}
+	if (i < n) {
+	    addtolist(list, count, name);
+	} else if (rootlist != NULL) {
+	    addtolist(rootlist, nrootlist, name);
+	}
+    }
+    freelist(passlist, npasslist);
+    for (i = 0; i < n && fscanf(refs, " %[^\n]", name) == 1; ++i) {
+	addtolist(passlist, npasslist, name);
+    }
+    fclose(refs);
+    return(YES);
+}
+
+
+/* use a shard's database as the cross-reference */
+
+static void
+useshard(int shard)
+{
+    static char *ref, *inv, *post;	/* its file names */
+    static char *mainref;		/* the shard list file name */
+
+    if (mainref == NULL) {
+	mainref = reffile;
+    }
+    free(ref);
+    free(inv);
+    free(post);
+    reffile = mainref;
+    ref = my_strdup(shardfile(shards[shard], ".out"));
+    inv = my_strdup(shardfile(shards[shard], ".in"));
+    post = my_strdup(shardfile(shards[shard], ".po"));
+    reffile = ref;
+    invname = inv;
+    invpost = post;
+}
+
+
+/* return the name of one of a shard's database files: the
+   cross-reference file name, a dot, the root with its slashes changed
+   to percent signs, or just a percent sign for the shard of other
+   files, and the suffix.  The suffix keeps a database for a root like
+   "c" from looking like a source file to -R */
+
+static char *
+shardfile(char *root, char *suffix)
+{
+    static char path[PATHLEN + 1];
+    char    *s;
+
+    if (strcmp(root, RESTROOT) == 0) {
+	root = "%";
+    }
+    snprintf(path, sizeof(path), "%s.%s%s", reffile, root, suffix);
+    for (s = path + strlen(reffile) + 1; *s != '\0'; ++s) {
+	if (*s == '/') {
+	    *s = '%';
+	}
+    }
+    return(path);
+}
+
+
+/* add a copy of a name to a list */
+
+static void
+addtolist(char ***list, int *count, char *name)
+{
+    *list = myrealloc(*list, (*count + 1) * sizeof(**list));
+    (*list)[(*count)++] = my_strdup(name);
+}
+
+
+/* free a list of names */
+
+static void
+freelist(char ***list, int *count)
+{
+    while (*count > 0) {
+	free((*list)[--*count]);
+    }
+    free(*list);
+    *list = NULL;
+}
+
+
+/* compare two names for qsort() and bsearch() */
+
+static int
+comparenames(const void *s1, const void *s2)
+{
+    return(strcmp(*((char **) s1), *((char **) s2)));
+}
@@ -0,0 +1,698 @@
+/*===========================================================================
+ Copyright (c) 1998-2000, The Santa Cruz Operation 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ *Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+
+ *Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ *Neither name of The Santa Cruz Operation nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+ IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ DAMAGE. 
+ =========================================================================*/
+
+/*	cscope - interactive C symbol cross-reference
+ *
+ *	trigram index of the source files
+ *
+ *	The --trigrams option builds an index beside the cross-reference
+ *	that lists the source files each string of three characters is
+ *	in, with the case of letters folded.  A text or egrep pattern
+ *	search then reads only the files that have every trigram of the
+ *	string a matching line must contain, and the files changed since
+ *	the index was built.  The index is for the source file list it was
+ *	built from, so all the files are read when the list is different
+ *	or the pattern has no such string of three or more characters.
+ *	The trigrams of the file names are indexed apart from those of the
+ *	text, so the file name and #include searches are narrowed too.
+ *	With an inverted index, the trigrams of its terms are indexed as
+ *	well, so a symbol search for a pattern with no prefix looks up
+ *	only the terms that may match rather than walk through them all.
+ *
+ *	The index file has a header line, a table of the trigrams in order
+ *	with the offsets of their lists, a table of the offsets of the
+ *	terms, the lists, which are of the differences between increasing
+ *	file or term numbers in 7 bit bytes, and the terms.
+ */
+
+#include "global.h"
+#include "alloc.h"
+#include "build.h"
+#include "trigram.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define	TRIGRAMHEADER	"cscope trigrams"	/* index file header */
+#define	TRIGRAMVERSION	3		/* its format, with terms */
+#define	TRIGRAMMASK	0xffffffu	/* the three characters of a key */
+#define	NAMETRIGRAM	0x1000000u	/* key flag for a file name trigram */
+#define	TERMTRIGRAM	0x2000000u	/* key flag for a term trigram */
+#define	NOTRIGRAM	(~0u)		/* key of an empty hash table slot */
+#define	HASHBITS	16		/* initial hash table size in bits */
+#define	MAXQUERY	255		/* trigrams of a string looked up */
+
+#define	fold(c)		((unsigned int) tolower((unsigned char) (c)))
+
+typedef	struct {		/* trigram in the index file's table */
+	unsigned int	key;	/* its characters, the first in the high bits */
+	unsigned int	offset;	/* offset of its file list */
+} TRIGRAMENTRY;
+
+typedef	struct {		/* trigram being indexed */
+	unsigned int	key;	/* its characters, or NOTRIGRAM */
+	unsigned int	last;	/* the last file number in its list plus 1 */
+	unsigned char	*list;	/* file list */
+	unsigned long	length;	/* its length */
+	unsigned long	size;	/* its allocated size */
+} TRIGRAM;
+
+BOOL	trigramindex = NO;	/* build the trigram index */
+char	*trigramfile = TRIGRAMS; /* trigram index file name */
+
+static	TRIGRAM	*trigrams;	/* hash table of the trigrams being indexed */
+static	int	hashbits;	/* its size in bits */
+static	unsigned long	ntrigrams;	/* trigrams in it */
+static	char	*terms;		/* the terms being indexed */
+static	unsigned long	termsize;	/* their size */
+static	unsigned long	mterms;	/* its allocated size */
+static	unsigned int	*termoffsets;	/* offset of each term */
+static	unsigned long	nterms;	/* number of terms */
+static	unsigned long	mtermoffsets;	/* number allocated */
+static	TRIGRAMENTRY *table;	/* mapped index file's trigram table */
+static	unsigned long	ntable;	/* trigrams in it */
+static	unsigned int	*termtable;	/* mapped index file's term offsets */
+static	unsigned long	ntermtable;	/* terms in it */
+static	unsigned char	*lists;	/* mapped index file's lists */
+static	char	*termnames;	/* mapped index file's terms */
+static	unsigned char	*seen;	/* bit map of the trigrams in a file */
+static	unsigned int	*keys;	/* the trigrams in a file */
+static	unsigned long	nkeys;	/* number of them */
+static	unsigned long	mkeys;	/* number allocated */
+
+/* Internal prototypes: */
+static	void	addkey(unsigned int key);
+static	void	addkeys(unsigned int file, unsigned int flag);
+static	void	addstring(char *s);
+static	void	addterm(char *term);
+static	void	addtrigram(unsigned int key, unsigned int file);
+static	BOOL	changedfile(unsigned long file, time_t indextime);
+static	int	comparekeys(const void *t1, const void *t2);
+static	int	comparetrigrams(const void *t1, const void *t2);
+static	unsigned char *counttrigrams(char *s, int length, unsigned int flag,
+				     unsigned long count, int *all);
+static	unsigned long long hashnames(void);
+static	void	indexterms(void);
+static	TRIGRAM	*lookuptrigram(unsigned int key);
+static	char	*mapindex(size_t *size, time_t *mtime);
+static	BOOL	writeindex(FILE *index);
+
+
+/* build the trigram index of the source files unless it is
+   up-to-date */
+
+void
+buildtrigrams(void)
+{
+    unsigned char buf[8 * BUFSIZ];
+    unsigned long i, j, n;
+    unsigned long count;	/* characters read from a file */
+    unsigned int key;
+    char    *newfile;		/* index file being written */
+    struct stat statstruct;
+    char    *map;
+    size_t  size;
+    time_t  mtime;
+    ssize_t len;
+    FILE    *index;
+    int     fd;
+
+    /* keep the index if it is for these files, none have changed, and
+       it is not older than the cross-reference */
+    if ((map = mapindex(&size, &mtime)) != NULL) {
+	munmap(map, size);
+	for (i = 0; i < nsrcfiles && changedfile(i, mtime) == NO; ++i) {
+	    ;
+	}
+	if (i == nsrcfiles && stat(reffile, &statstruct) == 0
+	    && statstruct.st_mtime <= mtime) {
+	    return;
+	}
+    }
+    seen = mycalloc((TRIGRAMMASK + 1) / 8, 1);
+    hashbits = HASHBITS;
+    trigrams = mymalloc(sizeof(*trigrams) << hashbits);
+    for (i = 0; i < 1UL << hashbits; ++i) {
+	trigrams[i].key = NOTRIGRAM;
+    }
+    ntrigrams = 0;
+
+    /* add each file to the lists of the trigrams in its text, unless
+       it cannot be read, when a search will find it has changed, and
+       then to those of the trigrams in its name */
+    for (i = 0; i < nsrcfiles; ++i) {
+	if ((fd = myopen(filepath(srcfiles[i]), O_RDONLY | O_BINARY, 0)) != -1) {
+	    key = 0;
+	    count = 0;
+	    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		for (j = 0; j < (unsigned long) len; ++j) {
+		    key = ((key << 8) | fold(buf[j])) & TRIGRAMMASK;
+		    if (++count >= 3
+			&& (seen[key >> 3] & (1 << (key & 7))) == 0) {
+			addkey(key);
+		    }
+		}
+	    }
+	    close(fd);
+	    addkeys(i, 0);
+	}
+	addstring(srcfiles[i]);
+	addkeys(i, NAMETRIGRAM);
+    }
+    /* and each term of the inverted index to the lists of the trigrams
+       in it */
+    nterms = termsize = 0;
+    if (invertedindex == YES) {
+	indexterms();
+    }
+    free(seen);
+    free(keys);
+    keys = NULL;
+    mkeys = 0;
+
+    /* put the trigrams in order at the start of the hash table */
+    for (i = n = 0; i < 1UL << hashbits; ++i) {
+	if (trigrams[i].key != NOTRIGRAM) {
+	    trigrams[n++] = trigrams[i];
+	}
+    }
+    qsort(trigrams, ntrigrams, sizeof(*trigrams), comparetrigrams);
+
+    /* write the index to a new file and replace the old one with it */
+    newfile = mymalloc(strlen(trigramfile) + 2);
+    strcpy(newfile, trigramfile);
+    strcpy(mybasename(newfile), "n");
+    strcat(newfile, mybasename(trigramfile));
+    if ((index = myfopen(newfile, "wb")) == NULL
+	|| writeindex(index) == NO
+	|| rename(newfile, trigramfile) == -1) {
+	posterr("cscope: cannot write the trigram index %s\n", trigramfile);
+	unlink(newfile);
+    }
+    free(newfile);
+    for (i = 0; i < ntrigrams; ++i) {
+	free(trigrams[i].list);
+    }
+    free(trigrams);
+    trigrams = NULL;
+    free(terms);
+    terms = NULL;
+    mterms = 0;
+    free(termoffsets);
+    termoffsets = NULL;
+    mtermoffsets = 0;
+}
+
+/* return the source files that may have the string s of the length in
+   their text now, in their text as it was cross-referenced, or in their
+   names, as an array of YES or NO for each file, or NULL if the trigram
+   index cannot tell */
+
+char *
+trigramfiles(char *s, int length, int kind)
+{
+    unsigned char *hits;	/* trigrams found in each file */
+    unsigned long i;
+    int     n;
+    char    *files;
+    char    *map;
+    size_t  size;
+    time_t  mtime;
+    struct stat statstruct;
+
+    if (length < 3 || nsrcfiles == 0
+	|| (map = mapindex(&size, &mtime)) == NULL) {
+	return(NULL);
+    }
+    /* an index older than the cross-reference may not have the text
+       that was cross-referenced */
+    if (kind == REFTRIGRAMS && (stat(reffile, &statstruct) != 0
+				|| statstruct.st_mtime > mtime)) {
+	munmap(map, size);
+	return(NULL);
+    }
+    hits = counttrigrams(s, length, kind == NAMETRIGRAMS ? NAMETRIGRAM : 0,
+			 nsrcfiles, &n);
+    munmap(map, size);
+
+    files = mymalloc(nsrcfiles + 1);
+    for (i = 0; i < nsrcfiles; ++i) {
+	if (hits[i] == n) {
+	    files[i] = YES;
+	} else if (kind == TEXTTRIGRAMS) {
+	    files[i] = changedfile(i, mtime);
+	} else {
+	    files[i] = NO;
+	}
+    }
+    free(hits);
+    return(files);
+}
+
+/* return the terms of the inverted index that may have the string s of
+   the length, in order, as a null terminated array allocated with them
+   to be freed at once, or NULL if the trigram index cannot tell */
+
+char **
+trigramterms(char *s, int length)
+{
+    unsigned char *hits;	/* trigrams found in each term */
+    unsigned long i, n;
+    unsigned long size;		/* of the terms found */
+    int     all;
+    char    **found;
+    char    *p;
+    char    *map;
+    size_t  mapsize;
+    time_t  mtime;
+    struct stat statstruct;
+
+    if (length < 3 || (map = mapindex(&mapsize, &mtime)) == NULL) {
+	return(NULL);
+    }
+    /* an index older than the cross-reference may not have its terms */
+    if (ntermtable == 0 || stat(reffile, &statstruct) != 0
+	|| statstruct.st_mtime > mtime) {
+	munmap(map, mapsize);
+	return(NULL);
+    }
+    hits = counttrigrams(s, length, TERMTRIGRAM, ntermtable, &all);
+    for (i = n = size = 0; i < ntermtable; ++i) {
+	if (hits[i] == all) {
+	    if (termtable[i] >= termtable[i + 1]
+		|| termtable[i + 1] > termtable[ntermtable]) {
+		free(hits);	/* a damaged index */
+		munmap(map, mapsize);
+		return(NULL);
+	    }
+	    ++n;
+	    size += termtable[i + 1] - termtable[i];
+	}
+    }
+    found = mymalloc((n + 1) * sizeof(*found) + size);
+    p = (char *) (found + n + 1);
+    for (i = n = 0; i < ntermtable; ++i) {
+	if (hits[i] == all) {
+	    found[n++] = p;
+	    size = termtable[i + 1] - termtable[i];
+	    memcpy(p, termnames + termtable[i], size);
+	    p[size - 1] = '\0';
+	    p += size;
+	}
+    }
+    found[n] = NULL;
+    free(hits);
+    munmap(map, mapsize);
+    return(found);
+}
+
+/* add a trigram to those in the file */
+
+static void
+addkey(unsigned int key)
+{
+    seen[key >> 3] |= 1 << (key & 7);
+    if (nkeys == mkeys) {
+	mkeys = mkeys == 0 ? 1024 : 2 * mkeys;
+	keys = myrealloc(keys, mkeys * sizeof(*keys));
+    }
+    keys[nkeys++] = key;
+}
+
+/* add the file to the lists of the trigrams in it, with the flag */
+
+static void
+addkeys(unsigned int file, unsigned int flag)
+{
+    unsigned long i;
+
+    for (i = 0; i < nkeys; ++i) {
+	seen[keys[i] >> 3] &= ~(1 << (keys[i] & 7));
+	addtrigram(keys[i] | flag, file);
+    }
+    nkeys = 0;
+}
+
+/* add the trigrams in the string to those being added */
+
+static void
+addstring(char *s)
+{
+    unsigned int key = 0;
+    unsigned long count;
+
+    for (count = 0; *s != '\0'; ++s) {
+	key = ((key << 8) | fold(*s)) & TRIGRAMMASK;
+	if (++count >= 3 && (seen[key >> 3] & (1 << (key & 7))) == 0) {
+	    addkey(key);
+	}
+    }
+}
+
+/* add the term to those indexed */
+
+static void
+addterm(char *term)
+{
+    unsigned long length = strlen(term) + 1;
+
+    addstring(term);
+    addkeys(nterms, TERMTRIGRAM);
+    if (nterms + 1 >= mtermoffsets) {
+	mtermoffsets = mtermoffsets == 0 ? 1024 : 2 * mtermoffsets;
+	termoffsets = myrealloc(termoffsets,
+				mtermoffsets * sizeof(*termoffsets));
+    }
+    if (termsize + length > mterms) {
+	mterms = mterms == 0 ? 8 * BUFSIZ : 2 * mterms;
+	terms = myrealloc(terms, mterms);
+    }
+    termoffsets[nterms++] = termsize;
+    strcpy(terms + termsize, term);
+    termsize += length;
+}
+
+/* add the file to the trigram's list */
+
+static void
+addtrigram(unsigned int key, unsigned int file)
+{
+    TRIGRAM *t;
+    TRIGRAM *old;
+    unsigned long delta;
+    unsigned long i;
+
+    /* keep the hash table at most half full */
+    if (2 * (ntrigrams + 1) > 1UL << hashbits) {
+	old = trigrams;
+	trigrams = mymalloc(sizeof(*trigrams) << ++hashbits);
+	for (i = 0; i < 1UL << hashbits; ++i) {
+	    trigrams[i].key = NOTRIGRAM;
+	}
+	for (i = 0; i < 1UL << (hashbits - 1); ++i) {
+	    if (old[i].key != NOTRIGRAM) {
+		*lookuptrigram(old[i].key) = old[i];
+	    }
+	}
+	free(old);
+    }
+    if ((t = lookuptrigram(key))->key == NOTRIGRAM) {
+	t->key = key;
+	t->last = 0;
+	t->list = NULL;
+	t->length = t->size = 0;
+	++ntrigrams;
+    }
+    if (t->length + 5 > t->size) {
+	t->size = t->size == 0 ? 8 : 2 * t->size;
+	t->list = myrealloc(t->list, t->size);
+    }
+    for (delta = file + 1 - t->last; delta >= 0x80; delta >>= 7) {
+	t->list[t->length++] = (delta & 0x7f) | 0x80;
+    }
+    t->list[t->length++] = delta;
+    t->last = file + 1;
+}
+
+/* return YES if the file may have changed since the index was built */
+
+static BOOL
+changedfile(unsigned long file, time_t indextime)
+{
+    struct stat statstruct;
+
+    if (stat(filepath(srcfiles[file]), &statstruct) != 0
+	|| statstruct.st_mtime >= indextime) {
+	return(YES);
+    }
+    return(NO);
+}
+
+/* compare a key with an index file table trigram's */
+
+static int
+comparekeys(const void *t1, const void *t2)
+{
+    unsigned int k1 = *(const unsigned int *) t1;
+    unsigned int k2 = ((const TRIGRAMENTRY *) t2)->key;
+
+    return(k1 < k2 ? -1 : k1 > k2);
+}
+
+/* compare two indexed trigrams' keys */
+
+static int
+comparetrigrams(const void *t1, const void *t2)
+{
+    unsigned int k1 = ((const TRIGRAM *) t1)->key;
+    unsigned int k2 = ((const TRIGRAM *) t2)->key;
+
+    return(k1 < k2 ? -1 : k1 > k2);
+}
+
+/* count the trigrams of the string s of the length, with the flag, in
+   the lists of each of count files or terms, returning the counts and
+   setting all to the number of trigrams that one that has them all has */
+
+static unsigned char *
+counttrigrams(char *s, int length, unsigned int flag, unsigned long count,
+	      int *all)
+{
+    TRIGRAMENTRY *t;
+    unsigned char *hits;	/* trigrams found in each file or term */
+    unsigned char *p, *end;
+    unsigned long item;
+    unsigned long delta;
+    unsigned long i;
+    unsigned int key;
+    int     shift;
+    int     n;
+
+    /* each file or term has them all if each has been counted in turn */
+    hits = mycalloc(count, 1);
+    key = (fold(s[0]) << 8) | fold(s[1]);
+    for (i = 2, n = 0; i < (unsigned long) length && n < MAXQUERY; ++i) {
+	key = (((key << 8) | fold(s[i])) & TRIGRAMMASK) | flag;
+	if ((t = bsearch(&key, table, ntable, sizeof(*table),
+			 comparekeys)) == NULL) {
+	    n = MAXQUERY + 1;	/* none has it */
+	    break;
+	}
+	p = lists + t->offset;
+	end = lists + t[1].offset;
+	if (t->offset > t[1].offset || t[1].offset > table[ntable].offset) {
+	    break;	/* a damaged index */
+	}
+	for (item = 0; p < end; ) {
+	    for (delta = 0, shift = 0; p < end - 1 && (*p & 0x80) != 0
+		 && shift < 28; shift += 7) {
+		delta |= (unsigned long) (*p++ & 0x7f) << shift;
+	    }
+	    item += delta | (unsigned long) (*p++ & 0x7f) << shift;
+	    if (item > 0 && item <= count && hits[item - 1] == n) {
+		hits[item - 1] = n + 1;
+	    }
+	}
+	++n;
+    }
+    *all = n;
+    return(hits);
+}
+
+/* hash the source file names so an index for other files is not used */
+
+static unsigned long long
+hashnames(void)
+{
+    unsigned long long h = 14695981039346656037ULL;	/* FNV-1a */
+    unsigned long i;
+    char    *s;
+
+    for (i = 0; i < nsrcfiles; ++i) {
+	for (s = srcfiles[i]; *s != '\0'; ++s) {
+	    h = (h ^ (unsigned char) *s) * 1099511628211ULL;
+	}
+	h = (h ^ '\n') * 1099511628211ULL;
+    }
+    return(h);
+}
+
+/* add the terms of the inverted index and any delta index, in the
+   order a search walks through them */
+
+static void
+indexterms(void)
+{
+    INVCONTROL invcntl;
+    char    term[PATLEN + 1];
+
+    if (opentermindex(&invcntl) == NO) {
+	return;
+    }
+    /* skip the null first term */
+    (void) invfind(&invcntl, "");
+    (void) invforward(&invcntl);
+    do {
+	(void) invterm(&invcntl, term);
+	addterm(term);
+    } while (invforward(&invcntl));
+    invclose(&invcntl);
+}
+
+/* find the trigram's hash table slot, or the empty one for it */
+
+static TRIGRAM *
+lookuptrigram(unsigned int key)
+{
+    unsigned long i = (unsigned int) (key * 2654435761u) >> (32 - hashbits);
+
+    while (trigrams[i].key != key && trigrams[i].key != NOTRIGRAM) {
+	i = (i + 1) & ((1UL << hashbits) - 1);
+    }
+    return(&trigrams[i]);
+}
+
+/* map the trigram index file into memory and point to its table and
+   lists, returning NULL if there is no index for the source files */
+
+static char *
+mapindex(size_t *size, time_t *mtime)
+{
+    struct stat statstruct;
+    char    header[100];
+    char    *map;
+    char    *p;
+    unsigned long nfiles;
+    unsigned long long names;
+    size_t  start;
+    size_t  rest;		/* size after the trigram table */
+    int     version;
+    int     fd;
+
+    if ((fd = myopen(trigramfile, O_RDONLY | O_BINARY, 0)) == -1) {
+	return(NULL);
+    }
+    if (fstat(fd, &statstruct) != 0 || statstruct.st_size == 0
+	|| (map = mmap(NULL, statstruct.st_size, PROT_READ, MAP_PRIVATE,
+		       fd, 0)) == MAP_FAILED) {
+	close(fd);
+	return(NULL);
+    }
+    close(fd);
+    *size = statstruct.st_size;
+    *mtime = statstruct.st_mtime;
+
+    /* check the header, and that the table and lists fit in the file */
+    if ((p = memchr(map, '\n', *size < sizeof(header) ? *size
+			   : sizeof(header))) != NULL) {
+	memcpy(header, map, p - map);
+	header[p - map] = '\0';
+	start = p + 1 - map;
+	table = (TRIGRAMENTRY *) (map + start);
+	if (sscanf(header, TRIGRAMHEADER " %d %lu %llu %lu %lu",
+		   &version, &nfiles, &names, &ntable, &ntermtable) == 5
+	    && version == TRIGRAMVERSION
+	    && nfiles == nsrcfiles && names == hashnames()
+	    && start % sizeof(*table) == 0
+	    && ntable < (*size - start) / sizeof(*table)) {
+	    termtable = (unsigned int *) (table + ntable + 1);
+	    rest = *size - ((char *) termtable - map);
+	    if (ntermtable < rest / sizeof(*termtable)) {
+		lists = (unsigned char *) (termtable + ntermtable + 1);
+		rest = *size - ((char *) lists - map);
+		termnames = (char *) lists + table[ntable].offset;
+		if (table[ntable].offset <= rest
+		    && termtable[ntermtable] == rest - table[ntable].offset
+		    && (termtable[ntermtable] == 0
+			|| termnames[termtable[ntermtable] - 1] == '\0')) {
+		    return(map);
+		}
+	    }
+	}
+    }
+    munmap(map, *size);
+    return(NULL);
+}
+
+/* write the indexed trigrams, which are in order, and terms to the index
+   file and close it, returning NO if it could not be written */
+
+static BOOL
+writeindex(FILE *index)
+{
+    TRIGRAMENTRY entry;
+    unsigned int end;		/* offset of the end of the terms */
+    char    header[100];
+    unsigned long i;
+    int     len;
+    BOOL    ok = YES;
+
+    /* pad the header so the table is aligned */
+    len = snprintf(header, sizeof(header), TRIGRAMHEADER " %d %lu %llu %lu %lu",
+		   TRIGRAMVERSION, nsrcfiles, hashnames(), ntrigrams, nterms);
+    while ((len + 1) % sizeof(entry) != 0) {
+	header[len++] = ' ';
+    }
+    header[len++] = '\n';
+    fwrite(header, 1, len, index);
+
+    entry.offset = 0;
+    for (i = 0; i < ntrigrams; ++i) {
+	entry.key = trigrams[i].key;
+	fwrite(&entry, sizeof(entry), 1, index);
+	if (trigrams[i].length > UINT_MAX - entry.offset) {
+	    ok = NO;	/* the lists are too long for the offsets */
+	}
+	entry.offset += trigrams[i].length;
+    }
+    entry.key = NOTRIGRAM;
+    fwrite(&entry, sizeof(entry), 1, index);
+    if (termsize > UINT_MAX) {
+	ok = NO;
+    }
+    fwrite(termoffsets, sizeof(*termoffsets), nterms, index);
+    end = termsize;
+    fwrite(&end, sizeof(end), 1, index);
+    for (i = 0; i < ntrigrams; ++i) {
+	fwrite(trigrams[i].list, 1, trigrams[i].length, index);
+    }
+    fwrite(terms, 1, termsize, index);
+    if (ferror(index)) {
+	ok = NO;
+    }
+    if (fclose(index) == EOF) {
+	ok = NO;
+    }
+    return(ok);
+}
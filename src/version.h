@@ -42,6 +42,8 @@
 #define CSCOPE_VERSION_H
 
 #define	FILEVERSION	15	/* Initial Open Source and Linux Port */
+#define	PACKEDVERSION	16	/* block-compressed (-z) cross-reference, so
+				   an older cscope rebuilds it */
 #define	FIXVERSION	".8b"	/* feature and bug fix version */
 
 #endif /* CSCOPE_VERSION_H */